@@ -0,0 +1,251 @@
+#include "app.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "scene.hpp"
+#include "allocations.hpp"
+#include "stubrenderstream.hpp"
+
+// headless benchmark, renders the real scene code for a stub renderstream session
+// and prints results as "name value" lines for the nightly perf tracking to pick up
+
+static int s_scenes = 1;
+static int s_objects = 50;
+
+// fills every scene with a grid of alternating cubes and spheres
+static void setupScenes(App& app)
+{
+    const int side = std::max(1, (int)std::ceil(std::sqrt((float)s_objects)));
+
+    // every scene and object goes to the stub in one rs_setSchema
+    SchemaTransaction transaction;
+
+    for (int i = 0; i < s_scenes; ++i)
+    {
+        Scene* scene = i ? app.addScene("scene " + std::to_string(i + 1)) : App::getCurrentScene();
+
+        for (int j = 0; j < s_objects; ++j)
+        {
+            ObjectArgs args;
+            args.pos = glm::vec3((j % side - side / 2) * 3.f, 0, (j / side - side / 2) * 3.f);
+            scene->addObject(j % 2 ? Object_Sphere : Object_Cube, args);
+        }
+    }
+}
+
+static void usage()
+{
+    printf("usage: RsTestBench [options]\n"
+           "  --streams N          simulated streams (4)\n"
+           "  --size W H           stream resolution (1920 1080)\n"
+           "  --format FMT         bgra8, rgba8, rgba16 or rgba32f (rgba8)\n"
+           "  --cameras N          distinct cameras the streams share, 0 for one each (0)\n"
+           "  --scenes M           scenes, cycled through with --scene-interval (1)\n"
+           "  --objects K          objects per scene (50)\n"
+           "  --scene-interval F   frames per scene, 0 stays on the first (0)\n"
+           "  --image W H          texture param size, 0 0 leaves objects untextured (0 0)\n"
+           "  --unique-images N    distinct images shared between objects, 0 for one each (0)\n"
+           "  --frames N           measured frames (1000)\n"
+           "  --warmup N           frames before measuring (100)\n"
+           "  --workers N          render on N worker threads, 0 renders on the main thread (0)\n"
+           "  --depth N            frame queue depth (1)\n"
+           "  --msaa N             samples per pixel, 1, 2, 4 or 8 (1)\n"
+           "  --target-fps N       scale streams down when frames can't keep up with N fps (off)\n"
+           "  --no-instancing      draw every object on its own\n"
+           "  --no-culling         draw objects outside a stream's view too\n"
+           "  --no-lod             draw spheres at full detail whatever their size\n"
+           "  --no-sharing         render streams with the same camera separately\n"
+           "  --frame-thread       await frames on their own thread\n"
+           "  --onscreen           use the display's gl instead of osmesa\n"
+           "  --csv PATH           write per frame timings to PATH\n");
+}
+
+static bool parseFormat(const char* name, RSPixelFormat& format)
+{
+    if (!strcmp(name, "bgra8"))         format = RS_FMT_BGRA8;
+    else if (!strcmp(name, "rgba8"))    format = RS_FMT_RGBA8;
+    else if (!strcmp(name, "rgba16"))   format = RS_FMT_RGBA16;
+    else if (!strcmp(name, "rgba32f"))  format = RS_FMT_RGBA32F;
+    else return false;
+    return true;
+}
+
+static float percentile(std::vector<float>& values, int p)
+{
+    if (values.empty())
+        return 0;
+    const size_t i = (values.size() - 1) * p / 100;
+    std::nth_element(values.begin(), values.begin() + i, values.end());
+    return values[i];
+}
+
+int main(int argc, char* argv[])
+{
+    StubConfig stubConfig;
+    LaunchOptions options;
+    options.headless = true;
+    options.loadRenderStream = false;
+#ifndef _WIN32
+    options.offscreen = true;
+#endif
+    std::string csvPath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        const bool hasPair = i + 2 < argc;
+
+        if (!strcmp(arg, "--streams") && hasValue)
+            stubConfig.streams = atoi(argv[++i]);
+        else if (!strcmp(arg, "--size") && hasPair)
+        {
+            stubConfig.width = atoi(argv[++i]);
+            stubConfig.height = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--format") && hasValue)
+        {
+            if (!parseFormat(argv[++i], stubConfig.format))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (!strcmp(arg, "--cameras") && hasValue)
+            stubConfig.cameras = std::max(0, atoi(argv[++i]));
+        else if (!strcmp(arg, "--scenes") && hasValue)
+            s_scenes = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(arg, "--objects") && hasValue)
+            s_objects = atoi(argv[++i]);
+        else if (!strcmp(arg, "--scene-interval") && hasValue)
+            stubConfig.sceneInterval = atoi(argv[++i]);
+        else if (!strcmp(arg, "--image") && hasPair)
+        {
+            stubConfig.imageWidth = atoi(argv[++i]);
+            stubConfig.imageHeight = atoi(argv[++i]);
+        }
+        else if (!strcmp(arg, "--unique-images") && hasValue)
+            stubConfig.uniqueImages = atoi(argv[++i]);
+        else if (!strcmp(arg, "--frames") && hasValue)
+            stubConfig.frames = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(arg, "--warmup") && hasValue)
+            stubConfig.warmup = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(arg, "--workers") && hasValue)
+        {
+            options.config.renderWorkers = atoi(argv[++i]);
+            options.config.parallelStreams = options.config.renderWorkers > 0;
+        }
+        else if (!strcmp(arg, "--depth") && hasValue)
+            options.config.frameQueueDepth = std::min(std::max(atoi(argv[++i]), 1), 3);
+        else if (!strcmp(arg, "--msaa") && hasValue)
+        {
+            // the mode is the power of two at or below the samples asked for
+            const int samples = atoi(argv[++i]);
+            options.config.msaa = 0;
+            while (options.config.msaa < 3 && 2 << options.config.msaa <= samples)
+                options.config.msaa++;
+        }
+        else if (!strcmp(arg, "--target-fps") && hasValue)
+        {
+            options.config.dynamicResolution = true;
+            options.config.targetFps = std::max(1, atoi(argv[++i]));
+        }
+        else if (!strcmp(arg, "--no-instancing"))
+            options.config.instancing = false;
+        else if (!strcmp(arg, "--no-culling"))
+            options.config.culling = false;
+        else if (!strcmp(arg, "--no-lod"))
+            options.config.lod = false;
+        else if (!strcmp(arg, "--no-sharing"))
+            options.config.shareRenders = false;
+        else if (!strcmp(arg, "--frame-thread"))
+            options.frameThread = true;
+        else if (!strcmp(arg, "--onscreen"))
+            options.offscreen = false;
+        else if (!strcmp(arg, "--csv") && hasValue)
+            csvPath = argv[++i];
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    // keep every measured frame, plus the one that gets quit
+    options.profileFrames = stubConfig.warmup + stubConfig.frames + 1;
+    options.setup = setupScenes;
+
+    stub::bind(stubConfig, allocations::getCount);
+
+    App app(options);
+    if (app.run())
+        return 1;
+
+    const StubStats& stats = stub::getStats();
+    Profiler& profiler = app.getProfiler();
+
+    // only iterations that rendered a measured frame. with the frame thread some
+    // iterations render nothing, so they're picked by frame rather than iteration
+    const int64_t first = stubConfig.warmup;
+    const int64_t last = stubConfig.warmup + stubConfig.frames;
+    std::vector<float> frameTimes;
+    double stages[Stage_Count] = {};
+    // gpu times of every stream in the measured frames, resolves on their own
+    double streamGpu = 0;
+    double streamResolve = 0;
+    double streamUpscale = 0;
+    int streamFrames = 0;
+    for (size_t i = 0; i < profiler.getCount(); ++i)
+    {
+        const FrameTiming& timing = profiler.getFrame(i);
+        if (timing.frame < first || timing.frame >= last)
+            continue;
+
+        frameTimes.push_back(timing.total);
+        for (int j = 0; j < Stage_Count; ++j)
+            stages[j] += timing.stages[j];
+
+        for (int j = 0; j < timing.streamCount; ++j)
+        {
+            streamGpu += timing.streams[j].ms[Stream_Gpu];
+            streamResolve += timing.streams[j].ms[Stream_Resolve];
+            streamUpscale += timing.streams[j].ms[Stream_Upscale];
+            streamFrames++;
+        }
+    }
+
+    const double seconds = stats.endTime - stats.startTime;
+
+    printf("streams %d\n", stubConfig.streams);
+    printf("resolution %ux%u\n", stubConfig.width, stubConfig.height);
+    printf("scenes %d\n", s_scenes);
+    printf("objects %d\n", s_objects);
+    printf("frames %d\n", stubConfig.frames);
+    printf("fps %.2f\n", seconds > 0 ? stubConfig.frames / seconds : 0);
+    printf("frame_ms_p50 %.3f\n", percentile(frameTimes, 50));
+    printf("frame_ms_p90 %.3f\n", percentile(frameTimes, 90));
+    printf("frame_ms_p99 %.3f\n", percentile(frameTimes, 99));
+    printf("frame_ms_max %.3f\n", percentile(frameTimes, 100));
+    printf("allocs_per_frame %.2f\n", (double)stats.allocations / stubConfig.frames);
+
+    for (int i = 0; i < Stage_Count; ++i)
+        printf("stage_%s_ms_avg %.3f\n", Profiler::getStageName(i), frameTimes.empty() ? 0 : stages[i] / frameTimes.size());
+
+    printf("stream_gpu_ms_avg %.3f\n", streamFrames ? streamGpu / streamFrames : 0);
+    printf("stream_resolve_ms_avg %.3f\n", streamFrames ? streamResolve / streamFrames : 0);
+    printf("stream_upscale_ms_avg %.3f\n", streamFrames ? streamUpscale / streamFrames : 0);
+
+    if (!csvPath.empty() && !profiler.writeCsv(csvPath))
+    {
+        fprintf(stderr, "failed to write %s\n", csvPath.c_str());
+        return 1;
+    }
+
+    return 0;
+}
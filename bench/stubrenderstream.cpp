@@ -0,0 +1,270 @@
+#include "stubrenderstream.hpp"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "utils.hpp"
+
+namespace stub {
+
+    static StubConfig s_config;
+    static StubStats s_stats;
+    static size_t (*s_allocCount)();
+    static size_t s_allocStart;
+    static std::vector<std::string> s_names;
+    // what setSchema kept of each scene. d3 copies the schema, the app's own can change
+    // under a frame thread's fetches
+    struct StubScene
+    {
+        uint64_t hash;
+        // defaults of the number params, in order, with the index of their param
+        std::vector<std::pair<uint32_t, NumericalDefaults>> numbers;
+    };
+    static std::vector<StubScene> s_scenes;
+    static int s_frame;
+    static double s_time;
+    static std::vector<uint8_t> s_pixels;
+
+    static RS_ERROR initialiseGpuOpenGl(HGLRC, HDC)
+    {
+        return RS_ERROR_SUCCESS;
+    }
+
+    static RS_ERROR logToD3(const char* msg)
+    {
+        std::cerr << msg << std::endl;
+        return RS_ERROR_SUCCESS;
+    }
+
+    static RS_ERROR getStreams(StreamDescriptions* desc, uint32_t* bytes)
+    {
+        const uint32_t needed = sizeof(StreamDescriptions) + s_config.streams * sizeof(StreamDescription);
+        if (!desc || *bytes < needed)
+        {
+            *bytes = needed;
+            return RS_ERROR_BUFFER_OVERFLOW;
+        }
+
+        // descriptions follow the header in the same buffer, like the real thing
+        desc->nStreams = s_config.streams;
+        desc->streams = reinterpret_cast<StreamDescription*>(desc + 1);
+
+        for (int i = 0; i < s_config.streams; ++i)
+        {
+            StreamDescription& stream = desc->streams[i];
+            stream = StreamDescription();
+            stream.handle = i + 1;
+            stream.channel = "bench";
+            stream.name = s_names[i].c_str();
+            stream.width = s_config.width;
+            stream.height = s_config.height;
+            stream.format = s_config.format;
+            stream.clipping.left = 0;
+            stream.clipping.right = 1;
+            stream.clipping.top = 0;
+            stream.clipping.bottom = 1;
+        }
+
+        return RS_ERROR_SUCCESS;
+    }
+
+    // frames are always ready, so there's never a timeout to honour
+    static RS_ERROR awaitFrameData(int /*timeoutMs*/, FrameData* data)
+    {
+        const int frame = s_frame++;
+
+        if (frame == s_config.warmup)
+        {
+            s_stats.startTime = glfwGetTime();
+            s_allocStart = s_allocCount ? s_allocCount() : 0;
+        }
+
+        if (frame == s_config.warmup + s_config.frames)
+        {
+            s_stats.endTime = glfwGetTime();
+            s_stats.allocations = s_allocCount ? s_allocCount() - s_allocStart : 0;
+            return RS_ERROR_QUIT;
+        }
+
+        // frames come at 60Hz as far as the app can tell, but as fast as it asks for them
+        s_time = frame / 60.0;
+
+        data->tTracked = s_time;
+        data->localTime = s_time;
+        data->localTimeDelta = 1 / 60.0;
+        data->frameRateNumerator = 60;
+        data->frameRateDenominator = 1;
+        data->flags = 0;
+        data->scene = 0;
+        if (s_config.sceneInterval && !s_scenes.empty())
+            data->scene = (frame / s_config.sceneInterval) % s_scenes.size();
+
+        return frame ? RS_ERROR_SUCCESS : RS_ERROR_STREAMS_CHANGED;
+    }
+
+    static RS_ERROR getFrameCamera(StreamHandle handle, CameraData* camera)
+    {
+        // every camera orbits the origin, a little way round from the last one
+        const StreamHandle id = s_config.cameras ? (handle - 1) % s_config.cameras + 1 : handle;
+        const float angle = s_time * .2f + id * .5f;
+
+        *camera = CameraData();
+        camera->id = id;
+        camera->x = cosf(angle) * 20.f;
+        camera->y = 2.f;
+        camera->z = sinf(angle) * 20.f;
+        camera->ry = glm::degrees(angle) + 90.f;
+        return RS_ERROR_SUCCESS;
+    }
+
+    static RS_ERROR sendFrame(StreamHandle, const SenderFrame*, const FrameResponseData*)
+    {
+        s_stats.framesSent++;
+        return RS_ERROR_SUCCESS;
+    }
+
+    static RS_ERROR setSchema(Schema* schema)
+    {
+        s_scenes.resize(schema->scenes.nScenes);
+
+        // d3 hashes each scene's parameters, the app only needs them to be stable
+        for (uint32_t i = 0; i < schema->scenes.nScenes; ++i)
+        {
+            RemoteParameters& scene = schema->scenes.scenes[i];
+            StubScene& kept = s_scenes[i];
+            kept.numbers.clear();
+            uint64_t hash = 14695981039346656037ull;
+            for (uint32_t j = 0; j < scene.nParameters; ++j)
+            {
+                const RemoteParameter& param = scene.parameters[j];
+                for (const char* c = param.key; *c; ++c)
+                    hash = (hash ^ (uint8_t)*c) * 1099511628211ull;
+                if (param.type == RS_PARAMETER_NUMBER)
+                    kept.numbers.push_back(std::make_pair(j, param.defaults.number));
+            }
+            scene.hash = hash;
+            kept.hash = hash;
+        }
+
+        return RS_ERROR_SUCCESS;
+    }
+
+    static const StubScene* findScene(uint64_t hash)
+    {
+        for (const StubScene& scene : s_scenes)
+            if (scene.hash == hash)
+                return &scene;
+        return nullptr;
+    }
+
+    static RS_ERROR getFrameParams(uint64_t hash, void* out, size_t size)
+    {
+        const StubScene* scene = findScene(hash);
+        if (!scene)
+            return RS_ERROR_INCORRECTSCHEMA;
+
+        // number params are packed together, image params are fetched separately.
+        // each one swings around its default by a few percent of its range
+        float* values = reinterpret_cast<float*>(out);
+        const size_t count = std::min(size / sizeof(float), scene->numbers.size());
+        for (size_t n = 0; n < count; ++n)
+        {
+            const uint32_t i = scene->numbers[n].first;
+            const NumericalDefaults& range = scene->numbers[n].second;
+            const float value = range.defaultValue + sinf(s_time + i) * (range.max - range.min) * .05f;
+            values[n] = std::min(std::max(value, range.min), range.max);
+        }
+
+        return RS_ERROR_SUCCESS;
+    }
+
+    static RS_ERROR getFrameImageData(uint64_t hash, ImageFrameData* out, size_t count)
+    {
+        if (!findScene(hash))
+            return RS_ERROR_INCORRECTSCHEMA;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i].width = s_config.imageWidth;
+            out[i].height = s_config.imageHeight;
+            out[i].format = RS_FMT_RGBA8;
+            out[i].imageId = (s_config.uniqueImages ? i % s_config.uniqueImages : i) + 1;
+        }
+
+        return RS_ERROR_SUCCESS;
+    }
+
+    static RS_ERROR getFrameImage(int64_t imageId, const SenderFrame* frame)
+    {
+        if (frame->type != RS_FRAMETYPE_OPENGL_TEXTURE)
+            return RS_ERROR_BADSTREAMTYPE;
+        // getFrameImageData hands out ids from 1
+        if (imageId < 1)
+            return RS_ERROR_NOTFOUND;
+
+        // stands in for d3 copying into the texture
+        glBindTexture(GL_TEXTURE_2D, frame->gl.texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, s_config.imageWidth, s_config.imageHeight,
+            utils::glFormat(RS_FMT_RGBA8), utils::glType(RS_FMT_RGBA8), s_pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        return RS_ERROR_SUCCESS;
+    }
+
+    static RS_ERROR shutdown()
+    {
+        return RS_ERROR_SUCCESS;
+    }
+
+    void bind(const StubConfig& config, size_t (*allocCount)())
+    {
+        s_config = config;
+        s_stats = StubStats();
+        s_allocCount = allocCount;
+        s_allocStart = 0;
+        s_scenes.clear();
+        s_frame = 0;
+        s_time = 0;
+
+        s_names.clear();
+        for (int i = 0; i < config.streams; ++i)
+            s_names.push_back("bench " + std::to_string(i + 1));
+
+        // checkerboard for every texture param
+        s_pixels.resize(config.imageWidth * config.imageHeight * 4);
+        for (uint32_t y = 0; y < config.imageHeight; ++y)
+        {
+            for (uint32_t x = 0; x < config.imageWidth; ++x)
+            {
+                const uint8_t value = ((x / 32 + y / 32) % 2) ? 255 : 64;
+                uint8_t* pixel = &s_pixels[(y * config.imageWidth + x) * 4];
+                pixel[0] = pixel[1] = pixel[2] = value;
+                pixel[3] = 255;
+            }
+        }
+
+        utils::rsInitialiseGpuOpenGl    = initialiseGpuOpenGl;
+        utils::logToD3                  = logToD3;
+        utils::rsGetStreams             = getStreams;
+        utils::rsSendFrame              = sendFrame;
+        utils::rsGetFrameCamera         = getFrameCamera;
+        utils::rsAwaitFrameData         = awaitFrameData;
+        utils::rsShutdown               = shutdown;
+        utils::rsSetSchema              = setSchema;
+        utils::rsGetFrameParams         = getFrameParams;
+        utils::rsGetFrameImageData      = getFrameImageData;
+        utils::rsGetFrameImage          = getFrameImage;
+    }
+
+    const StubStats& getStats()
+    {
+        return s_stats;
+    }
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "platform.hpp"
+#include <d3renderstream.h>
+
+// the simulated d3 session the benchmark renders for
+struct StubConfig
+{
+    int streams = 4;
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    RSPixelFormat format = RS_FMT_RGBA8;
+    // frames measured, the stub asks the app to quit after warmup + frames
+    int frames = 1000;
+    // frames left out of the results while caches and pools fill up
+    int warmup = 100;
+    // frames spent on each scene before moving to the next, 0 stays on the first
+    int sceneInterval = 0;
+    // size of the image given to every texture param, 0 leaves objects untextured
+    uint32_t imageWidth = 0;
+    uint32_t imageHeight = 0;
+    // distinct images the objects cycle through, 0 gives every object its own
+    int uniqueImages = 0;
+    // distinct cameras the streams are spread over, 0 gives every stream its own
+    int cameras = 0;
+};
+
+struct StubStats
+{
+    int framesSent = 0;
+    // glfw time at the end of warmup and when quit was returned
+    double startTime = 0;
+    double endTime = 0;
+    // heap allocations between the end of warmup and quit
+    size_t allocations = 0;
+};
+
+namespace stub {
+
+    // point the utils rs functions at the stub, allocCount is read at the
+    // start and end of the measured frames
+    void bind(const StubConfig& config, size_t (*allocCount)());
+
+    const StubStats& getStats();
+
+}
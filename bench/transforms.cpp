@@ -0,0 +1,108 @@
+#include "transforms.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+// times every transform kernel the cpu supports on the same params and checks
+// the simd ones against the scalar one, results are "name value" lines like RsTestBench
+
+static void usage()
+{
+    printf("usage: RsTestTransformBench [options]\n"
+           "  --objects N      objects per run (10000)\n"
+           "  --runs N         runs per kernel, the fastest is kept (200)\n");
+}
+
+int main(int argc, char* argv[])
+{
+    size_t objects = 10000;
+    int runs = 200;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--objects") && hasValue)
+            objects = std::max(1, atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--runs") && hasValue)
+            runs = std::max(1, atoi(argv[++i]));
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    // kernels work on whole blocks, same as TransformStore pads to
+    objects = (objects + TRANSFORM_BLOCK - 1) / TRANSFORM_BLOCK * TRANSFORM_BLOCK;
+
+    // the same ranges the object params have in d3
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> position(-100, 100);
+    std::uniform_real_distribution<float> rotation(0, 359);
+    std::uniform_real_distribution<float> scale(0, 10);
+
+    std::vector<float> columns[Param_Count];
+    const float* columnPtrs[Param_Count];
+    for (int i = 0; i < Param_Count; ++i)
+    {
+        columns[i].resize(objects);
+        columnPtrs[i] = columns[i].data();
+        for (float& value : columns[i])
+        {
+            if (i <= Param_PosZ)        value = position(rng);
+            else if (i <= Param_RotZ)   value = rotation(rng);
+            else                        value = scale(rng);
+        }
+    }
+
+    std::vector<glm::mat4> reference(objects);
+    std::vector<glm::mat4> out(objects);
+    transforms::getKernel(Kernel_Scalar)(columnPtrs, 0, objects, reference.data());
+
+    printf("objects %d\n", (int)objects);
+    printf("best_kernel %s\n", transforms::getKernelName(transforms::getBestKernel()));
+
+    double scalarNs = 0;
+    for (int k = 0; k < Kernel_Count; ++k)
+    {
+        const TransformKernel kernel = (TransformKernel)k;
+        const transforms::BuildFn build = transforms::getKernel(kernel);
+        const char* name = transforms::getKernelName(kernel);
+        if (!build)
+        {
+            printf("kernel_%s unsupported\n", name);
+            continue;
+        }
+
+        double best = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            build(columnPtrs, 0, objects, out.data());
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+
+        float error = 0;
+        for (size_t i = 0; i < objects; ++i)
+            for (int col = 0; col < 4; ++col)
+                for (int row = 0; row < 4; ++row)
+                    error = std::max(error, std::fabs(out[i][col][row] - reference[i][col][row]));
+
+        const double ns = best / objects;
+        if (kernel == Kernel_Scalar)
+            scalarNs = ns;
+
+        printf("kernel_%s_ns_per_object %.2f\n", name, ns);
+        printf("kernel_%s_speedup %.2f\n", name, ns > 0 ? scalarNs / ns : 0);
+        printf("kernel_%s_max_error %g\n", name, error);
+    }
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+// counts calls to the global operator new when RSTEST_COUNT_ALLOCS is defined
+// (debug builds and the benchmark), used to keep the steady state frame loop
+// free of heap allocations
+namespace allocations {
+
+    // total since startup
+    size_t getCount();
+
+    // false when counting is compiled out and getCount is always 0
+    bool isCounting();
+
+}
@@ -7,13 +7,22 @@
 #define GLEW_STATIC
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
-#include <windows.h>
 #include <unordered_map>
+#include <map>
+#include <vector>
 #include <d3renderstream.h>
 
+#include "platform.hpp"
 #include "utils.hpp"
+#include "rendercontext.hpp"
+#include "profiler.hpp"
+#include "targetmanager.hpp"
+#include "resolutionscaler.hpp"
+#include "framearrival.hpp"
 
+class App;
 class Scene;
+class RenderWorker;
 
 struct ObjectConfig
 {
@@ -37,12 +46,71 @@ struct FrameInfo
 struct Metrics
 {
     float fps;
+    // frames rendered but not yet handed to rs_sendFrame
+    int framesInFlight = 0;
+    // rs_setSchema calls since startup
+    int schemaUploads = 0;
+    // streams last frame that copied another stream's image instead of rendering
+    int rendersSaved = 0;
+    // heap allocations made during the last main loop iteration
+    size_t frameAllocations = 0;
+    // iterations in a row where nothing about the scene or streams changed
+    int steadyFrames = 0;
 };
 
 // struct to store state of controls in ui window
 struct Config
 {
     ColourSpace colourSpace;
+    // draw untextured objects with one instanced call per mesh
+    bool instancing = true;
+    // skip objects whose bounding sphere is outside the stream's view
+    bool culling = true;
+    // render streams that would come out the same once and copy the image to the rest
+    bool shareRenders = true;
+    // draw spheres with fewer triangles the smaller they are on screen
+    bool lod = true;
+    // fraction past a level's threshold an object's projected size has to get
+    // before it changes level
+    float lodHysteresis = .2f;
+    // render streams on worker threads with their own gl contexts
+    bool parallelStreams = false;
+    int renderWorkers = 2;
+    // render targets per stream, 1 sends each frame as soon as it is rendered (lowest latency),
+    // more lets the next frame render while earlier ones are still in flight (higher throughput)
+    int frameQueueDepth = 1;
+    // msaa mode of streams without their own, an index into msaaModes
+    int msaa = 0;
+    // msaa modes picked for single streams in the ui
+    std::map<StreamHandle, int> streamMsaa;
+    // render streams smaller when frames can't keep up with targetFps, and stretch
+    // them back to size. never smaller than minScale of their size
+    bool dynamicResolution = false;
+    int targetFps = 60;
+    float minScale = .5f;
+    // times per second the ui window is redrawn, independent of the stream rate
+    int uiRefreshRate = 30;
+};
+
+// options given on the command line
+struct LaunchOptions
+{
+    // run without the ui window, only rendering streams
+    bool headless = false;
+    // create gl contexts with osmesa instead of on a display, for machines without a gpu
+    bool offscreen = false;
+    // load d3renderstream.dll, turned off when the utils rs functions have been
+    // pointed somewhere else beforehand (the benchmark's stub)
+    bool loadRenderStream = true;
+    // wait for frames from d3 on their own thread, the main thread only picks them up.
+    // every renderstream call is made under one lock then
+    bool frameThread = false;
+    // main loop iterations kept by the profiler
+    int profileFrames = 240;
+    // called once the gl context and first scene exist, to build scenes without the ui
+    void (*setup)(App& app) = nullptr;
+    // starting values for the controls
+    Config config;
 };
 
 struct UiState
@@ -56,36 +124,31 @@ struct UiState
     bool exit = false;
 };
 
+// changes made in the ui, applied at the start of the next frame. configs are
+// copied in place rather than allocated so queuing a change doesn't hit the heap
 struct UpdateQueue
 {
-    ObjectConfig* addObject = nullptr;
+    bool hasAddObject = false;
+    ObjectConfig addObject;
+    // deallocated by Scene::removeObject
     Object* removeObject = nullptr;
-    SceneConfig* addScene = nullptr;
+    bool hasAddScene = false;
+    SceneConfig addScene;
     void clear()
     {
-        // do not deallocate the object being removed as this has to be passed to
-        // Scene::removeObject and will then be deallocated
-        if (addObject != nullptr)
-        {
-            delete addObject;
-        }
-        if (addScene != nullptr)
-        {
-            delete addScene;
-        }
-
-        addObject = nullptr;
+        hasAddObject = false;
         removeObject = nullptr;
-        addScene = nullptr;
+        hasAddScene = false;
     }
     bool empty()
     {
-        return !addObject && !removeObject && !addScene;
+        return !hasAddObject && !removeObject && !hasAddScene;
     }
 };
 
 class App {
 private:
+    LaunchOptions m_options;
     GLFWwindow* m_window;
     GLFWwindow* m_uiWindow;
     Metrics m_metrics;
@@ -93,11 +156,11 @@ private:
     FrameInfo m_frameInfo;
     float m_windowWidth;
     float m_windowHeight;
-    std::vector<Scene> m_scenes;
+    std::vector<Scene*> m_scenes;
     Scene* m_currentScene;
     static App* s_instance;
     HMODULE m_rsLib;
-    TargetMap m_targets;
+    TargetManager m_targets;
     FrameData m_frame;
     RsSchema m_schema;
     const StreamDescriptions* m_header;
@@ -107,22 +170,93 @@ private:
     std::vector<float> m_params;
     std::vector<ImageFrameData> m_imgData;
     uint64_t m_hash;
+    // null when frames are awaited on the main thread
+    FrameArrival* m_arrival;
+    // the frame last taken from m_arrival, readable until the next is taken
+    ArrivedFrame* m_arrived;
+    std::vector<SceneLayout> m_layouts;
+    // whether handleStreams got a frame to render
+    bool m_frameReady;
+    RenderContext* m_context;
+    std::vector<RenderWorker*> m_workers;
+    std::vector<StreamJob> m_jobs;
+    // rendered jobs waiting for their fence before being sent, oldest first
+    std::vector<StreamJob> m_pending;
+    // one parameter snapshot per frame that can be in flight
+    std::vector<std::vector<float>> m_paramHistory;
+    uint64_t m_frameIndex;
+    int m_targetDepth;
+    // samples each stream's targets were last made with, in stream order
+    std::vector<int> m_targetSamples;
+    // whether the targets were made with a scaled target per stream
+    bool m_targetScaling;
+    ResolutionScaler m_scaler;
+    double m_lastUiTime;
+    // set by anything that may allocate as part of a change (streams, targets,
+    // scene edits), the frame it happens in isn't expected to be allocation free
+    bool m_stateChanged;
+    bool m_allocsReported;
+    // open schema transactions, and whether the schema changed since it was last sent
+    int m_schemaEditDepth;
+    bool m_schemaDirty;
+    Profiler m_profiler;
+    std::vector<GpuTiming> m_gpuTimes;
     int loadRenderStream();
     int handleStreams();
+    // keep every scene's layout and hash from the schema d3 has, for the arrival thread
+    void publishLayouts();
+    // (re)create queue depth render targets for every stream
+    void createTargets();
+    void destroyTargets();
+    // samples a stream should be rendered with, from its own msaa mode or the default
+    int getStreamSamples(StreamHandle handle);
+    // move the resolution scale on from how long the last frame took, and log changes
+    void updateResolutionScale();
+    // send pending frames whose fences have signalled, blocking on the
+    // oldest ones while more than maxPending frames are queued
+    int flushFrames(int maxPending);
+    void dropPending();
     int sendFrames();
+    // start or stop render workers to match the config
+    void updateWorkers();
+    void renderParallel();
+    // blit the images of streams that shared a render from the one that rendered it
+    void copySharedRenders();
+    int submitFrame(const StreamJob& job);
+    // hand gpu times that have come back from every context to the profiler
+    void collectGpuTimes();
     void measureFps();
+    // check the iteration's allocations once the loop has settled
+    void measureAllocations(size_t allocsBefore);
     void renderUi();
 public:
-    App();
+    App(const LaunchOptions& options = LaunchOptions());
     int run();
     float getWindowWidth();
     float getWindowHeight();
     void setWindowWidth(float width);
     void setWindowHeight(float height);
+    Scene* addScene(const std::string& name);
+    Profiler& getProfiler();
     static App* getInstance();
     static RsSchema& getSchema();
     static const std::vector<float>& getParams();
     static const std::vector<ImageFrameData>& getImgData();
     static Scene* getCurrentScene();
+    static const Config& getConfig();
+    // mark the schema as changed. it's sent to d3 when the outermost transaction
+    // ends, or otherwise at the start of the next frame, so any number of edits
+    // in a frame cost one rs_setSchema
     static void reloadSchema();
+    // send the schema now if it has changed, returns non zero on failure
+    static int flushSchema();
+    static void beginSchemaEdit();
+    static void endSchemaEdit();
+};
+
+// batches every schema edit made while it's alive into one rs_setSchema
+struct SchemaTransaction
+{
+    SchemaTransaction() { App::beginSchemaEdit(); }
+    ~SchemaTransaction() { App::endSchemaEdit(); }
 };
\ No newline at end of file
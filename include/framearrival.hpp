@@ -0,0 +1,90 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <d3renderstream.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// what the arrival thread needs to fetch a scene's parameters, from the schema d3 last got
+struct SceneLayout
+{
+    uint64_t hash = 0;
+    uint32_t numbers = 0;
+    uint32_t images = 0;
+};
+
+// everything renderstream had to say about one frame, short of its images. renderstream's
+// per frame calls answer for the frame last awaited, so cameras and parameters are
+// fetched before the next await
+struct ArrivedFrame
+{
+    RS_ERROR status = RS_ERROR_SUCCESS;
+    // set when status is an error that didn't come from rs_awaitFrameData
+    std::string error;
+    FrameData frame = {};
+    // new stream list, points into desc. only set when status is RS_ERROR_STREAMS_CHANGED
+    const StreamDescriptions* header = nullptr;
+    std::vector<uint8_t> desc;
+    // in the order of the stream list
+    std::vector<CameraData> cameras;
+    std::vector<uint8_t> camerasOk;
+    // hash of the layout params and images were fetched with, 0 if there wasn't one for the scene
+    uint64_t hash = 0;
+    std::vector<float> params;
+    std::vector<ImageFrameData> images;
+    bool paramsOk = false;
+    bool imagesOk = false;
+};
+
+// waits on rs_awaitFrameData on its own thread, so the main thread isn't held up behind
+// it. frames are handed over in two buffers, frame n in m_frames[n % 2], with a count
+// of frames published by the thread and one of frames released by the taker. the thread
+// only awaits the next frame once the taker has released every one it published, so
+// renderstream's calls for a frame are made before the next await, but the taker can
+// keep reading a released frame while the next one is awaited into the other buffer.
+// renderstream calls from both threads have to go through utils::serialiseRsCalls
+class FrameArrival
+{
+private:
+    std::thread m_thread;
+    ArrivedFrame m_frames[2];
+    // written with release by one side, read with acquire by the other. they're all the
+    // two sides share for a frame, handing one over takes no lock
+    std::atomic<uint64_t> m_published;
+    std::atomic<uint64_t> m_released;
+    // taker side only, frames taken so far
+    uint64_t m_taken;
+    std::atomic<bool> m_quit;
+    // a side with nothing to do parks on m_parkCv. the other only takes m_parkMutex
+    // to wake it when it says it's parked
+    std::atomic<bool> m_takerParked;
+    std::atomic<bool> m_threadParked;
+    std::mutex m_parkMutex;
+    std::condition_variable m_parkCv;
+    // written by the taker before a release, read by the thread after it
+    std::vector<SceneLayout> m_layouts;
+    // thread side only, handles of the current stream list for fetching cameras
+    std::vector<StreamHandle> m_handles;
+    void run();
+    void receive(ArrivedFrame& out);
+    // park until ready() or timeout seconds, returns ready()
+    template <typename Ready>
+    bool park(std::atomic<bool>& parked, Ready ready, double timeout);
+    void wake(std::atomic<bool>& parked);
+public:
+    // layouts of every scene in schema order, for the first frame
+    FrameArrival(const std::vector<SceneLayout>& layouts);
+    ~FrameArrival();
+    // the next frame if one arrives within timeout seconds, null otherwise. returns
+    // straight away if one is already waiting. the last frame taken is released first
+    ArrivedFrame* take(double timeout);
+    // every renderstream call for the taken frame that has to come before the next
+    // await has been made, the thread can await the next one. the frame stays readable
+    // until the next take. layouts are the scenes' as they are now, for the next
+    // frame's fetches. does nothing if the frame was already released
+    void release(const std::vector<SceneLayout>& layouts);
+};
@@ -4,6 +4,7 @@
 #include <glm/vec4.hpp>
 
 class Object;
+class RenderContext;
 
 class LightSource{
 private:
@@ -13,7 +14,7 @@ private:
     Object* m_obj;
 public:
     LightSource(glm::vec3 position, float brightness=0.0f, float ambientStrength=0.0f, glm::vec4 colour=glm::vec4(), Object* obj=nullptr);
-    void render();
+    void render(RenderContext& ctx);
     float getBrightness();
     void setBrightness(float brightness);
     glm::vec3 getPosition();
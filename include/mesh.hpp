@@ -0,0 +1,38 @@
+#pragma once
+
+#include <map>
+#include <unordered_set>
+
+#include "scene.hpp"
+#include "utils.hpp"
+
+// shares one set of gl buffers between every object with the same mesh key,
+// meshes are built on first use and freed when their last object goes away
+class MeshRegistry
+{
+private:
+    struct Entry
+    {
+        VertexArray* mesh;
+        int refs;
+    };
+    static std::map<MeshKey, Entry> s_meshes;
+    // VertexArray ids of the meshes above
+    static std::unordered_set<unsigned int> s_ids;
+    static int s_freed;
+public:
+    static VertexArray* acquire(const MeshKey& key, MeshBuilder build);
+    static void release(const MeshKey& key);
+    // acquire every level's mesh from its key, and release them
+    static void acquire(MeshLods& lods, MeshBuilder build);
+    static void release(MeshLods& lods);
+    static int getMeshCount();
+    // contexts keep a vertex array object per mesh id, when the count of freed meshes has
+    // moved on since they last looked they drop the ones whose mesh is no longer live
+    static int getFreedCount();
+    static bool isLive(unsigned int id);
+    // bytes of vertex and index data uploaded to the gpu
+    static size_t getBytesUsed();
+    // bytes that would have been uploaded if every object owned its own mesh
+    static size_t getBytesSaved();
+};
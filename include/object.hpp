@@ -7,10 +7,12 @@
 #include "lightsource.hpp"
 #include "scene.hpp"
 #include "utils.hpp"
+#include "texturepool.hpp"
 
 #include "d3renderstream.h"
 
 class Scene;
+class RenderContext;
 
 struct Texture
 {
@@ -18,27 +20,49 @@ struct Texture
     GLenum target;
 };
 
+// handle to an object in its scene's ObjectStore. name, transform and mesh
+// live in the store's arrays, the object only keeps what the render loop
+// never touches, like the texture it borrowed from the pool
 class Object
 {
 private:
-    std::string m_name;
-    glm::vec3 m_position;
-    glm::vec3 m_size;
     Scene* m_scene;
-    glm::mat4 m_model;
-    glm::mat4 m_rotation;
+    // index into the scene's ObjectStore, changes when another object is removed
+    size_t m_slot;
+    // borrowed from TexturePool while the object fetches its own image
     Texture m_texture;
-    glm::vec2 m_lastTexSize;
+    // texture drawn with, either m_texture or another object's with the same image
+    GLuint m_drawTexture;
+    TextureKey m_textureKey;
+    // image last pulled into m_texture, only pulled again when d3 gives a new one
+    int64_t m_imageId;
+    bool m_textured;
+    void releaseTexture();
 protected:
     ObjectType m_type;
-    VertexArray m_vao;
+    // shared with every other object using the same mesh keys, owned by MeshRegistry
+    MeshLods m_meshes;
+    // acquire the meshes for m_meshes' keys, releasing the ones held before,
+    // and hand them to the scene's store
+    void setMeshes(const MeshLods& lods, MeshBuilder build);
 public:
-    Object(const char* name);
+    // takes a slot in the scene's store, given back when the object is deleted
     Object(Scene* scene, glm::vec3 pos, glm::vec3 size, const std::string& name);
-    // take in image data to update texture
-    virtual void update(const ImageFrameData& imgData = ImageFrameData());
-    virtual void draw();
-    void rotate(float deg, glm::vec3 dir);
+    virtual ~Object();
+    // take in image data to update texture, main thread only. if imageSource is given it
+    // has already fetched this frame's image and its texture is sampled instead.
+    // returns true if the image was fetched from d3
+    virtual bool update(const ImageFrameData& imgData = ImageFrameData(), Object* imageSource = nullptr);
+    virtual void draw(RenderContext& ctx);
+    size_t getSlot();
+    void setSlot(size_t slot);
+    const glm::mat4& getModel();
+    // finest level of the object's mesh
+    VertexArray* getVertexArray();
+    const MeshKey& getMeshKey();
+    const MeshLods& getMeshes();
+    bool isTextured();
+    GLuint getTexture();
     glm::vec3 getPosition();
     void setPosition(glm::vec3 pos);
     glm::vec3 getSize();
@@ -46,4 +70,4 @@ public:
     void setSize(glm::vec3 size);
     void setRotation(float x, float y, float z);
     const char* getName();
-};
\ No newline at end of file
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+// the renderstream header and app use a few windows types, these stand in
+// for them on linux where only the benchmark (with a stub renderstream) runs
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cstring>
+typedef void* HMODULE;
+typedef void* HGLRC;
+typedef void* HDC;
+#endif
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <d3renderstream.h>
+#include <vector>
+#include <string>
+
+// parts of a main loop iteration that are timed on the cpu
+enum ProfileStage
+{
+    Stage_Await,    // rs_awaitFrameData
+    Stage_Params,   // rs_getFrameParameters
+    Stage_Images,   // rs_getFrameImageData
+    Stage_Update,   // scene update, including texture param fetches
+    Stage_Render,   // rendering every stream
+    Stage_Send,     // waiting on fences and rs_sendFrame
+    Stage_Ui,
+    Stage_Count
+};
+
+enum StreamStat
+{
+    Stream_Render,  // cpu time spent issuing the stream's draws
+    Stream_Gpu,     // gpu time between timestamps around the stream's draws
+    Stream_Resolve, // gpu time of the multisample resolve blit, 0 without msaa
+    Stream_Upscale, // gpu time stretching a scaled down render to the stream's size
+    Stream_Send,    // rs_sendFrame for the stream
+    Stream_StatCount
+};
+
+struct StreamTiming
+{
+    StreamHandle handle;
+    float ms[Stream_StatCount];
+};
+
+// streams past this are left out of the per stream times
+#define PROFILER_MAX_STREAMS 16
+
+// everything timed during one main loop iteration, all times in ms
+struct FrameTiming
+{
+    uint64_t index;
+    // frame counter value of the frame rendered this iteration, -1 if none was
+    int64_t frame;
+    float stages[Stage_Count];
+    float total;
+    // per stream times belong to the rendered frame, sends and gpu times
+    // are filled in later when that frame is sent or its queries are read.
+    // fixed size so recording never allocates
+    StreamTiming streams[PROFILER_MAX_STREAMS];
+    int streamCount;
+};
+
+struct TimingStats
+{
+    float min = 0;
+    float avg = 0;
+    float p99 = 0;
+};
+
+struct GpuTiming
+{
+    uint64_t frame;
+    StreamHandle handle;
+    StreamStat stat;
+    float ms;
+};
+
+// GL_TIMESTAMP queries around stream renders, read back once the gpu has
+// got to them so nothing ever waits. queries aren't shared between contexts,
+// so each render context has its own
+class GpuTimer
+{
+private:
+    struct Query
+    {
+        GLuint begin;
+        GLuint end;
+        uint64_t frame;
+        StreamHandle handle;
+        StreamStat stat;
+        bool pending;
+    };
+    std::vector<Query> m_queries;
+    size_t m_next;
+public:
+    // up to three queries per stream a frame, with msaa and resolution scaling
+    GpuTimer(size_t capacity = 192);
+    ~GpuTimer();
+    void begin(uint64_t frame, StreamHandle handle, StreamStat stat = Stream_Gpu);
+    void end();
+    // append the timings that are available so far to out
+    void collect(std::vector<GpuTiming>& out);
+};
+
+// ring buffer of the last few hundred main loop iterations
+class Profiler
+{
+private:
+    std::vector<FrameTiming> m_frames;
+    size_t m_head;
+    size_t m_count;
+    uint64_t m_index;
+    double m_frameStart;
+    std::vector<float> m_scratch;
+    FrameTiming& current();
+    // newest record that rendered frame, nullptr if it has left the ring
+    FrameTiming* find(uint64_t frame);
+    // min, avg and p99 of the values in m_scratch
+    TimingStats scratchStats();
+public:
+    Profiler(size_t capacity = 240);
+    void beginFrame();
+    void endFrame();
+    void setFrame(uint64_t frame);
+    void addStage(ProfileStage stage, float ms);
+    void addStreamTime(uint64_t frame, StreamHandle handle, StreamStat stat, float ms);
+
+    // number of finished iterations in the ring
+    size_t getCount();
+    // i counts from the oldest finished iteration
+    const FrameTiming& getFrame(size_t i);
+    // stats over the ring, pass Stage_Count for whole iteration time
+    TimingStats getStats(int stage);
+    // stats over the iterations that recorded stat for the stream
+    TimingStats getStreamStats(StreamHandle handle, StreamStat stat);
+
+    // one row per stream per iteration, returns false if the file couldn't be written
+    bool writeCsv(const std::string& path);
+
+    static const char* getStageName(int stage);
+};
+
+// adds the time between construction and destruction to a stage
+struct ProfileScope
+{
+    Profiler& profiler;
+    ProfileStage stage;
+    double start;
+    ProfileScope(Profiler& profiler, ProfileStage stage);
+    ~ProfileScope();
+};
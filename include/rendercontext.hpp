@@ -0,0 +1,129 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <glm/matrix.hpp>
+#include <d3renderstream.h>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include "scene.hpp"
+#include "utils.hpp"
+#include "profiler.hpp"
+
+class Object;
+class ShaderProgram;
+class UniformBuffer;
+class RenderContext;
+
+// collects the model matrices of objects sharing a mesh so they can be
+// drawn with a single glDrawElementsInstanced call
+class InstanceBatch
+{
+private:
+    unsigned int m_vbo;
+    size_t m_capacity;
+    VertexArray* m_mesh;
+    // models from earlier frames are kept and compared against, so a batch
+    // whose objects didn't move isn't uploaded again
+    std::vector<glm::mat4> m_models;
+    size_t m_count;
+    bool m_changed;
+public:
+    InstanceBatch();
+    ~InstanceBatch();
+    void clear();
+    void add(VertexArray* mesh, const glm::mat4& model);
+
+    // upload matrices if any changed and issue the draw, does nothing if batch is empty
+    void draw(RenderContext& ctx);
+
+    size_t getCount();
+};
+
+// everything needed to render and submit one stream, gathered on the main thread
+struct StreamJob
+{
+    Scene* scene;
+    StreamHandle handle;
+    // frame counter value when this was rendered
+    uint64_t frame;
+    uint64_t schemaHash;
+    // snapshot of the frame's parameters, kept until the job is sent
+    const std::vector<float>* params;
+    uint32_t width;
+    uint32_t height;
+    const RenderTarget* target;
+    // size the scene is drawn at, smaller than width and height when resolution scaling
+    // has kicked in. while scaling is on it's drawn into scaled, and stretched into target
+    uint32_t renderWidth;
+    uint32_t renderHeight;
+    const RenderTarget* scaled;
+    CameraBlock camera;
+    CameraResponseData cameraResponse;
+    // signalled once the stream's frame is finished on the gpu
+    GLsync fence;
+    // cpu time spent rendering, in ms
+    float renderTime;
+    DrawStats stats;
+    // index in the stream list, picks the stream's levels of detail in the scene's store
+    size_t stream;
+    // index in the frame's jobs of a stream with the same scene, camera and size whose
+    // image is copied into this one instead of rendering it again, -1 if this one renders
+    int source;
+};
+
+// gl state that can't be shared between contexts (vertex array objects, framebuffers,
+// uniform values and binding points) or that is written per stream. there is one of
+// these for the main context and one per render worker, all scene data is shared
+class RenderContext
+{
+private:
+    GLFWwindow* m_window;
+    ShaderProgram* m_shader;
+    SceneUniforms m_uniforms;
+    UniformBuffer* m_frameUniforms;
+    // keyed by VertexArray::getId, not pointer, as freed meshes can have their address reused
+    std::unordered_map<unsigned int, GLuint> m_vaos;
+    // MeshRegistry's freed count when m_vaos was last swept
+    int m_meshesFreed;
+    // keyed by the target's colour texture
+    std::unordered_map<GLuint, GLuint> m_framebuffers;
+    std::unordered_map<GLuint, GLuint> m_resolveBuffers;
+    std::map<MeshKey, InstanceBatch*> m_batches;
+    GpuTimer* m_timer;
+    // delete the vertex array objects of meshes the registry has freed
+    void sweepMeshes();
+public:
+    // window's context must be current on the calling thread for the lifetime of this
+    RenderContext(GLFWwindow* window);
+    ~RenderContext();
+    GLFWwindow* getWindow();
+    ShaderProgram* getShader();
+    const SceneUniforms& getUniforms();
+    UniformBuffer& getFrameUniforms();
+
+    void bindMesh(VertexArray* mesh);
+
+    // framebuffer in this context drawing into target's texture, or its multisampled
+    // colour buffer, and depth buffer
+    GLuint getFramebuffer(const RenderTarget& target);
+    // framebuffer in this context with only target's texture, to resolve into.
+    // 0 if the target isn't multisampled
+    GLuint getResolveFramebuffer(const RenderTarget& target);
+    // drop framebuffers after the stream targets have been recreated
+    void clearFramebuffers();
+
+    void clearBatches();
+    void addInstance(const MeshKey& key, VertexArray* mesh, const glm::mat4& model);
+    void drawBatches();
+    // draw one mesh on its own, texture 0 draws it untextured
+    void drawMesh(VertexArray* mesh, const glm::mat4& model, GLuint texture);
+
+    // draw the job's stream into its target with this context's framebuffers and set its
+    // render time. multisample resolves and upscales are timed apart from the draws
+    void render(StreamJob& job);
+    // gpu times of earlier renders in this context that have finished
+    void collectGpuTimes(std::vector<GpuTiming>& out);
+};
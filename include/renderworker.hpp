@@ -0,0 +1,45 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "rendercontext.hpp"
+
+// renders a share of the streams on its own thread, with a hidden window whose
+// context shares textures and buffers with the main context. scene data is only
+// read while the worker is busy, the main thread must not touch it until wait() returns
+class RenderWorker
+{
+private:
+    GLFWwindow* m_window;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<StreamJob*> m_jobs;
+    // gpu times read back on the worker's context, valid after wait()
+    std::vector<GpuTiming> m_gpuTimes;
+    GLsync m_updateFence;
+    bool m_busy;
+    bool m_targetsChanged;
+    bool m_quit;
+    void run();
+public:
+    // must be called on the main thread, glfw can only create windows there
+    RenderWorker(GLFWwindow* share);
+    ~RenderWorker();
+    // false if the worker's window couldn't be created, it can't be given jobs
+    bool isRunning() const;
+    void clearJobs();
+    void addJob(StreamJob* job);
+    // render queued jobs once the gpu has passed updateFence
+    void start(GLsync updateFence);
+    // block until every queued job has been rendered and given a fence
+    void wait();
+    // stream targets were recreated, framebuffers have to be rebuilt
+    void invalidateTargets();
+    const std::vector<GpuTiming>& getGpuTimes();
+};
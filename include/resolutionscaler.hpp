@@ -0,0 +1,20 @@
+#pragma once
+
+// picks the fraction of their size streams are rendered at so frames keep up with a
+// target rate. drops straight to what the last frame suggests so one heavy frame
+// doesn't turn into a run of dropped ones, and climbs back a step at a time once
+// there's been headroom for a while, so it doesn't bounce between two scales
+class ResolutionScaler
+{
+private:
+    float m_scale;
+    // frames in a row with headroom, the scale only goes up after enough of them
+    int m_headroomFrames;
+public:
+    ResolutionScaler();
+    // feed the time the last frame took to produce, returns true if the scale changed
+    bool update(float frameMs, float targetFps, float minScale);
+    // back to full size, for when scaling is turned off
+    void reset();
+    float getScale();
+};
@@ -3,11 +3,14 @@
 #include <glm/matrix.hpp>
 #include <vector>
 #include <string>
+#include <map>
+#include <tuple>
 #include <d3renderstream.h>
 
 #include "camera.hpp"
 #include "utils.hpp"
 #include "lightsource.hpp"
+#include "transforms.hpp"
 
 #if !defined(VEC0)
 #define VEC0 glm::vec3(0,0,0)
@@ -17,8 +20,13 @@
 #endif
 
 class RsScene;
+struct ParamLayout;
 class Object;
 class LightSource;
+class ShaderProgram;
+class RenderContext;
+class VertexArray;
+struct StreamJob;
 
 enum ObjectType {
     Object_Cube,
@@ -34,36 +42,190 @@ struct ObjectArgs {
     int sectorCount = 36;
 };
 
+// identifies the geometry an object is drawn with, objects
+// with equal keys can be drawn in the same instanced batch
+struct MeshKey {
+    ObjectType type;
+    int stackCount = 0;
+    int sectorCount = 0;
+    bool operator<(const MeshKey& other) const
+    {
+        return std::tie(type, stackCount, sectorCount) < std::tie(other.type, other.stackCount, other.sectorCount);
+    }
+};
+
+// builds the geometry for a key into an empty vertex array
+typedef void (*MeshBuilder)(VertexArray& vao, const MeshKey& key);
+
+// most levels of detail a mesh can have
+#define MESH_LODS 3
+
+// the meshes an object can be drawn with, finest first. objects with
+// nothing to simplify, like cubes, have a single level
+struct MeshLods {
+    MeshKey keys[MESH_LODS];
+    VertexArray* meshes[MESH_LODS] = {};
+    int count = 0;
+};
+
+// binding points of the uniform blocks shared by all scene shaders
+enum UniformBlock {
+    Block_Camera,
+    Block_Lighting
+};
+
+// std140 mirror of CameraBlock in the scene shader, written per stream
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 proj;
+};
+
+// the six planes of a camera's view volume, normals pointing inwards
+struct Frustum {
+    glm::vec4 planes[6];
+    Frustum(const glm::mat4& viewProj);
+    // false only if the sphere (centre in xyz, radius in w) is entirely outside
+    bool intersects(const glm::vec4& sphere) const;
+};
+
+// what drawing one stream cost
+struct DrawStats {
+    // objects kept and dropped by culling
+    int drawn = 0;
+    int culled = 0;
+    // triangles of the level of detail each object was drawn at, and
+    // what they would have been at the finest level
+    int triangles = 0;
+    int fullTriangles = 0;
+};
+
+// std140 mirror of LightingBlock in the scene shader, written per scene
+struct LightingBlock {
+    glm::vec4 lightPos;
+    glm::vec4 lightColour;
+    glm::vec4 ambientColour;
+    float lightBrightness;
+    float ambientStrength;
+    float pad[2];
+};
+
+// handles of the scene shader's uniforms, looked up once after linking
+struct SceneUniforms {
+    int model;
+    int instanced;
+    int isTextured;
+    int texture;
+};
+
+// a scene's objects packed into parallel arrays by slot. removing an object
+// moves the last one into its slot, so the arrays stay dense and the update
+// and render loops walk them front to back instead of chasing Object pointers
+class ObjectStore
+{
+private:
+    std::vector<Object*> m_objects;
+    std::vector<std::string> m_names;
+    std::vector<MeshLods> m_meshes;
+    // texture each object is drawn with, 0 if it's untextured this frame
+    std::vector<unsigned int> m_textures;
+    // where each object's values are in the frame's number and image arrays
+    std::vector<uint32_t> m_numberOffsets;
+    std::vector<uint32_t> m_imageOffsets;
+    // world space bounding sphere of each object, centre in xyz and radius in w
+    std::vector<glm::vec4> m_bounds;
+    // level of detail each object was last drawn at, one per stream for each slot.
+    // kept with the slot so it moves with its object
+    std::vector<uint8_t> m_lods;
+    size_t m_lodStreams = 0;
+    TransformStore m_transforms;
+public:
+    static const uint32_t NO_PARAMS = 0xffffffff;
+
+    // objects add and remove themselves, add returns the new object's slot
+    size_t add(Object* obj, const std::string& name, glm::vec3 pos, glm::vec3 size);
+    void remove(size_t slot);
+    void setMeshes(size_t slot, const MeshLods& lods);
+    void setTexture(size_t slot, unsigned int texture);
+    // make room for a level of detail per stream, levels start from scratch when the count changes
+    void setLodStreams(size_t streams);
+    // point every object at its values, needed whenever the param layout changes
+    void setParamOffsets(const ParamLayout& layout);
+    // fit every object's bounding sphere to its mesh and model, after the models are built
+    void updateBounds();
+
+    size_t getCount();
+    const std::vector<Object*>& getObjects();
+    Object* getObject(size_t slot);
+    const char* getName(size_t slot);
+    const MeshLods& getMeshes(size_t slot);
+    unsigned int getTexture(size_t slot);
+    uint32_t getNumberOffset(size_t slot);
+    uint32_t getImageOffset(size_t slot);
+    const glm::vec4& getBounds(size_t slot);
+    // streams render on different threads, but each only touches its own levels
+    uint8_t& getLod(size_t slot, size_t stream);
+    TransformStore& getTransforms();
+};
+
 class Scene {
 private:
     std::string m_name;
     Camera* m_currentCamera;
-    unsigned int m_shader;
     glm::mat4 m_view;
     glm::mat4 m_projection;
-    std::vector<Object*> m_objects;
+    ObjectStore m_store;
+    // the store's param offsets are refreshed on the next update
+    bool m_offsetsDirty;
     LightSource m_light;
     std::vector<Camera*> m_cameras;
     RsScene* m_rsScene;
     float m_ambStrength;
     glm::vec4 m_ambColour;
+    LightingBlock m_lighting;
+    // image id and the object that fetched it this frame, reused every frame
+    std::vector<std::pair<int64_t, Object*>> m_imageSources;
+    int m_transformsUpdated;
+    int m_imageFetches;
+    int m_imageFetchesSaved;
 public:
     Scene(std::string name);
     ~Scene();
+    // compile the shader every scene is drawn with and look up its uniforms,
+    // called once per gl context
+    static ShaderProgram* createShader(SceneUniforms& uniforms);
     void updateMatrices();
-    void render();
+    CameraBlock getCameraBlock();
+    // apply this frame's parameters to lighting and objects and fetch their
+    // textures, has to run on the main thread once per frame
+    void update();
+    // draw the objects the job's camera can see into the bound framebuffer with ctx's
+    // shader and buffers, filling in the job's stats. scene state is only read here, so
+    // several contexts can render the same scene at once
+    void render(RenderContext& ctx, StreamJob& job);
     Object* addObject(ObjectType type, ObjectArgs args);
     void removeObject(Object* obj);
-    unsigned int getShader();
     Camera* addCamera(glm::vec3 pos = VEC0, float fov = 45.f);
     Camera* getCurrentCamera();
     const char* getName();
 
     const std::vector<Object*>& getObjects();
     const std::vector<Camera*>& getCameras();
+    ObjectStore& getStore();
 
     int getObjectCount();
     int getObjectCount(ObjectType type);
+    // objects whose params changed last update, the rest kept their model matrix
+    int getTransformsUpdated();
+    TransformKernel getTransformKernel();
+    // images pulled from d3 last update, and pulls skipped because
+    // another object already had the same image
+    int getImageFetches();
+    int getImageFetchesSaved();
+    // where each object's params are in the frame's number and image arrays
+    const ParamLayout& getParamLayout();
+    // memory held by the scene's parameter strings, and what interning saved
+    size_t getParamBytes();
+    size_t getParamBytesSaved();
 
     Object* operator [](int i);
 };
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/matrix.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// wraps a linked program, active uniforms are reflected once at link time and
+// set through integer handles so nothing is looked up by name while rendering.
+// the last uploaded value of each uniform is cached so redundant uploads are skipped,
+// which relies on the program being bound with use() before any setter is called
+class ShaderProgram
+{
+private:
+    struct Uniform
+    {
+        GLint location;
+        GLenum type;
+        GLint size;
+        bool set;
+        float value[16];
+    };
+    unsigned int m_id;
+    std::vector<Uniform> m_uniforms;
+    std::unordered_map<std::string, int> m_handles;
+    // copy data into the uniform's cache, returns false if it was already there
+    bool cache(int handle, const void* data, size_t size);
+public:
+    ShaderProgram(const GLchar* vsSrc[], const GLchar* fsSrc[]);
+    ~ShaderProgram();
+    void use();
+    unsigned int getId();
+
+    // connect the named uniform block to a buffer binding point
+    void bindBlock(const std::string& name, GLuint binding);
+
+    // returns -1 if name is not an active uniform, setters ignore -1 handles
+    int getUniform(const std::string& name);
+
+    void setInt(int handle, int value);
+    void setFloat(int handle, float value);
+    void setVec3(int handle, const glm::vec3& value);
+    void setVec4(int handle, const glm::vec4& value);
+    void setMat4(int handle, const glm::mat4& value);
+};
+
+// one gl buffer holding several std140 uniform blocks, each bound to its own
+// binding point. blocks are staged on the cpu and everything that changed since
+// the last upload is sent with a single glBufferSubData
+class UniformBuffer
+{
+private:
+    struct Block
+    {
+        GLuint binding;
+        size_t offset;
+        size_t size;
+    };
+    unsigned int m_ubo;
+    std::vector<Block> m_blocks;
+    std::vector<uint8_t> m_data;
+    size_t m_dirtyBegin;
+    size_t m_dirtyEnd;
+    Block* getBlock(GLuint binding);
+public:
+    UniformBuffer();
+    ~UniformBuffer();
+    // reserve space for a block, all blocks must be added before build()
+    void addBlock(GLuint binding, size_t size);
+    // lay out blocks at the required alignment, create the buffer and bind the ranges
+    void build();
+    void write(GLuint binding, const void* data, size_t size);
+    void upload();
+};
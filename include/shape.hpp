@@ -11,10 +11,15 @@
 
 #define WHITE glm::vec3(1,1,1)
 
+// coarsest a sphere's levels of detail get, each level halves the one before
+#define SPHERE_MIN_STACKS 4
+#define SPHERE_MIN_SECTORS 8
+
 class Cube : public Object 
 {
 public:
     Cube(Scene* scene, glm::vec3 pos, float size, const std::string& name, glm::vec3 colour=WHITE);
+    static void buildMesh(VertexArray& vao, const MeshKey& key);
 };
 
 class Sphere : public Object 
@@ -22,10 +27,13 @@ class Sphere : public Object
 private:
     int m_stackCount;
     int m_sectorCount;
+    // acquire a mesh per level of detail for the current stacks and sectors
+    void updateMeshes();
 public:
     Sphere(Scene* scene, glm::vec3 pos, float size, const std::string& name, int stackCount, int sectorCount, glm::vec3 colour=WHITE);
     int getStacks();
     void setStacks(int count);
     int getSectors();
     void setSectors(int count);
+    static void buildMesh(VertexArray& vao, const MeshKey& key);
 };
\ No newline at end of file
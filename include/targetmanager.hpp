@@ -0,0 +1,54 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <d3renderstream.h>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.hpp"
+#include "texturepool.hpp"
+
+// render targets of every stream, kept across stream changes. when d3 changes the
+// stream list only streams that are new, gone or have a new size or format get
+// targets made or freed, the rest keep theirs. main context only
+class TargetManager
+{
+private:
+    struct Entry
+    {
+        StreamTargets targets;
+        TextureKey key;
+        int samples = 1;
+        // whether the buffers were made to be blitted into from scaled targets
+        bool scaling = false;
+        // set for every stream in the latest list, the ones left unset are freed
+        bool seen = false;
+    };
+    std::unordered_map<StreamHandle, Entry> m_streams;
+    size_t m_bytes;
+    int m_made;
+    int m_freed;
+    int m_kept;
+    int m_maxSamples;
+    // a target that's only blitted into gets just its texture and a framebuffer for it
+    void create(RenderTarget& target, const TextureKey& key, int samples, bool blitOnly);
+    void destroy(RenderTarget& target, const TextureKey& key);
+    // colour and depth buffers of one target
+    static size_t getBytes(const TextureKey& key, const RenderTarget& target);
+public:
+    TargetManager();
+    // give every stream in header depth targets of its size and format, multisampled
+    // with samples[i] samples for stream i, and a scaled target per buffer if scaling is on.
+    // returns true if any were made or freed. nothing may still be rendering into
+    // or waiting to send a stream's targets
+    bool update(const StreamDescriptions* header, int depth, const std::vector<int>& samples, bool scaling);
+    void clear();
+    StreamTargets& get(StreamHandle handle);
+    int getTargetCount();
+    // gpu memory held by every target
+    size_t getBytes();
+    // what the last update did with each target
+    int getMade();
+    int getFreed();
+    int getKept();
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <d3renderstream.h>
+#include <tuple>
+#include <map>
+#include <vector>
+
+struct TextureKey
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    RSPixelFormat format = RS_FMT_INVALID;
+    bool operator<(const TextureKey& other) const
+    {
+        return std::tie(width, height, format) < std::tie(other.width, other.height, other.format);
+    }
+    bool operator!=(const TextureKey& other) const
+    {
+        return width != other.width || height != other.height || format != other.format;
+    }
+};
+
+// textures for image params, reused between objects and frames instead of being
+// created whenever an image changes size. allocated with immutable storage as
+// their size never changes once made. main thread only
+class TexturePool
+{
+private:
+    struct Entry
+    {
+        std::vector<GLuint> free;
+        int used = 0;
+    };
+    static std::map<TextureKey, Entry> s_textures;
+    static int s_total;
+    static int s_used;
+    static size_t s_bytes;
+public:
+    // a texture of the key's size and format, made if none are free
+    static GLuint acquire(const TextureKey& key);
+    static void release(const TextureKey& key, GLuint texture);
+    // textures handed out right now
+    static int getUsedCount();
+    // every texture the pool owns, used or free
+    static int getTotalCount();
+    static size_t getBytes();
+    static size_t getBytesPerPixel(RSPixelFormat format);
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <glm/matrix.hpp>
+#include <glm/vec3.hpp>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// number params of each object, in the order Scene::addObject adds them.
+// the texture param comes after these
+enum ObjectParam
+{
+    Param_PosX,
+    Param_PosY,
+    Param_PosZ,
+    Param_RotX,
+    Param_RotY,
+    Param_RotZ,
+    Param_ScaleX,
+    Param_ScaleY,
+    Param_ScaleZ,
+    Param_Count
+};
+
+enum TransformKernel
+{
+    Kernel_Scalar,  // glm, one object at a time
+    Kernel_Sse,     // four objects at a time
+    Kernel_Avx2,    // eight objects at a time
+    Kernel_Count
+};
+
+// objects are stored and rebuilt in blocks of this many, so every kernel
+// always works on whole registers
+#define TRANSFORM_BLOCK 8
+
+namespace transforms {
+
+    // build out[first, first + count) from one column per ObjectParam,
+    // count has to be a multiple of TRANSFORM_BLOCK
+    typedef void (*BuildFn)(const float* const* columns, size_t first, size_t count, glm::mat4* out);
+
+    // nullptr if the kernel isn't supported by this cpu or build
+    BuildFn getKernel(TransformKernel kernel);
+    // fastest kernel the cpu supports, checked once
+    TransformKernel getBestKernel();
+    const char* getKernelName(TransformKernel kernel);
+
+}
+
+// object params of a scene as structure of arrays, one column per ObjectParam,
+// so model matrices can be built several objects at a time. only blocks with
+// an object whose params changed are rebuilt
+class TransformStore
+{
+private:
+    std::vector<float> m_columns[Param_Count];
+    std::vector<glm::mat4> m_models;
+    std::vector<uint8_t> m_dirtyBlocks;
+    size_t m_count;
+    TransformKernel m_kernel;
+    transforms::BuildFn m_build;
+    // returns true if any of the values differed
+    bool write(size_t i, int first, const float* values, int count);
+public:
+    TransformStore();
+    // new objects are at the origin with no rotation and a scale of one
+    size_t add();
+    // the last object moves into i
+    void remove(size_t i);
+    // copy the object's params in, returns false if they're the same as last time
+    bool set(size_t i, const float* params);
+    // the same as setting the params they're built from, and just as
+    // likely to be overwritten by d3 next frame
+    void setPosition(size_t i, glm::vec3 pos);
+    void setSize(size_t i, glm::vec3 size);
+    void setRotation(size_t i, float x, float y, float z);
+    // rebuild the models of every block with a change
+    void build();
+    const glm::mat4& getModel(size_t i);
+    glm::vec3 getPosition(size_t i);
+    glm::vec3 getSize(size_t i);
+    size_t getCount();
+    TransformKernel getKernel();
+};
@@ -1,20 +1,25 @@
 #pragma once
 
+#include "platform.hpp"
+
 #include <GL/glew.h>
 #ifdef __APPLE__
 #include <OpenGL/GLU.h>
-#endif
-#ifdef _WIN32
+#elif defined(_WIN32)
 #include <GL/GLU.h>
+#else
+#include <GL/glu.h>
 #endif
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
+#include <glm/matrix.hpp>
 #include <GLFW/glfw3.h>
 #include <stb/stb_image.h>
 #include <d3renderstream.h>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "scene.hpp"
 
@@ -30,7 +35,14 @@ class Object;
 
 struct RenderTarget {
     GLuint texture;
+    GLuint depthBuf;
+    // what the stream is rendered into
     GLuint frameBuf;
+    // multisampled colour buffer frameBuf draws into instead of texture, and a framebuffer
+    // with just texture attached that it's resolved into. both 0 without msaa
+    GLuint colourBuf;
+    GLuint resolveBuf;
+    int samples;
 };
 
 enum ColourSpace
@@ -39,19 +51,108 @@ enum ColourSpace
     COLOURSPACE_SRGB,
 };
 
-typedef std::unordered_map<StreamHandle, RenderTarget> TargetMap;
+// render targets for one stream, cycled through so the next frame can be
+// rendered while earlier ones are still waiting to be sent
+struct StreamTargets {
+    std::vector<RenderTarget> buffers;
+    size_t next = 0;
+    // one per buffer while resolution scaling is on, rendered into at a fraction of the
+    // stream's size and stretched into the buffer of the same index. made at full size so
+    // the scale can change without new targets. the buffers are then only blitted into,
+    // so they're made without depth or multisampled colour
+    std::vector<RenderTarget> scaled;
+};
 
 static const char* colourSpaces[] = { "RGB", "sRGB" };
 static const char* objectTypes[] = { "Cube", "Sphere" };
+// mode i renders with 1 << i samples
+static const char* msaaModes[] = { "Off", "2x", "4x", "8x" };
+
+// owns the strings of a scene's parameters, packed into a few large blocks
+// instead of a malloc each. strings are interned so every object's "pos_x"
+// and group name is stored once
+class StringArena
+{
+private:
+    // compare the strings rather than the pointers, so the set doesn't need copies of them
+    struct StrHash { size_t operator()(const char* str) const; };
+    struct StrEqual { bool operator()(const char* a, const char* b) const; };
+
+    static const size_t BLOCK_SIZE = 4096;
+    std::vector<char*> m_blocks;
+    size_t m_blockUsed;
+    size_t m_bytesReserved;
+    size_t m_bytesUsed;
+    size_t m_bytesSaved;
+    std::unordered_set<const char*, StrHash, StrEqual> m_strings;
+    void* alloc(size_t size, size_t align);
+public:
+    StringArena();
+    ~StringArena();
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+
+    const char* intern(const char* str);
+    // array of interned copies of strs, not interned itself
+    const char** internArray(const char* const* strs, size_t count);
+    void swap(StringArena& other);
+
+    // bytes of the blocks, bytes handed out and bytes repeats didn't need
+    size_t getBytesReserved();
+    size_t getBytesUsed();
+    size_t getBytesSaved();
+};
+
+// where one object's params are, both in the scene's parameter list and in
+// the number and image arrays d3 fills each frame
+struct ParamSlice
+{
+    Object* obj;
+    uint32_t first;
+    uint32_t count;
+    // index of the object's first value in App::getParams and App::getImgData
+    uint32_t number;
+    uint32_t image;
+    uint16_t numbers;
+    uint16_t images;
+};
+
+// the scene's object slices in parameter order, and how many number and
+// image params the scene has altogether
+struct ParamLayout
+{
+    std::vector<ParamSlice> slices;
+    uint32_t numbers = 0;
+    uint32_t images = 0;
+};
 
 class RsScene : public RemoteParameters
 {
 private:
     std::vector<RemoteParameter> m_params;
+    StringArena m_strings;
+    ParamLayout m_layout;
+    // index into m_layout.slices of each object's slice
+    std::unordered_map<Object*, size_t> m_sliceIndices;
+    // arena bytes of params removed since it was last compacted. shared strings
+    // are counted too, so it's an upper bound on what compacting would free
+    size_t m_deadBytes;
+    // slice offsets and indices are stale after a remove that couldn't swap
+    bool m_layoutDirty;
+    // point the param's strings into the arena
+    void internParam(RemoteParameter& param, StringArena& arena);
 public:
     RsScene();
-    void addParam(RemoteParameter param);
+    // the param's strings are copied, so it can be a temporary. an object's
+    // params have to be added one after another
+    void addParam(const RemoteParameter& param, Object* obj = nullptr);
+    // finds the object's slice through its handle instead of comparing names, and
+    // moves the last object's params into its place. removed objects' strings stay
+    // in the arena until they make up half of it, then the rest move into a fresh one
     void removeParamsForObj(Object* obj);
+    StringArena& getStrings();
+    // offsets are worked out again here if a remove left them stale
+    const ParamLayout& getLayout();
 };
 
 class RsSchema : public Schema
@@ -66,41 +167,72 @@ public:
     void reloadScene(RsScene& scene);
 };
 
+// the param's strings point into the param itself until it's added to an RsScene,
+// so it can't be copied
 class RsFloatParam : public RemoteParameter
 {
+private:
+    std::string m_key;
+    std::string m_display;
+    std::string m_group;
+    std::vector<std::string> m_options;
+    std::vector<const char*> m_optionPtrs;
 public:
     RsFloatParam(const std::string& key, const std::string& display,
         const std::string& group, float defaultVal, float min = 0, float max = 255,
         float step = 1, const std::vector<std::string>& opt = {}, bool allowSequencing = true);
+    RsFloatParam(const RsFloatParam&) = delete;
+    RsFloatParam& operator=(const RsFloatParam&) = delete;
 };
 
 class RsTextureParam : public RemoteParameter
 {
+private:
+    std::string m_key;
+    std::string m_display;
+    std::string m_group;
 public:
     RsTextureParam(const std::string& key, const std::string& display,
         const std::string& group);
+    RsTextureParam(const RsTextureParam&) = delete;
+    RsTextureParam& operator=(const RsTextureParam&) = delete;
 };
 
+// vertex and index buffers of a mesh. vertex array objects can't be shared between
+// gl contexts, so each RenderContext creates its own and calls setupAttribs on it
 class VertexArray
 {
 private:
-    unsigned int m_vao;
+    static unsigned int s_nextId;
+    unsigned int m_id;
     unsigned int m_vbo;
     unsigned int m_ibo;
     std::vector<float> m_vertices;
     std::vector<unsigned int> m_indices;
+    float m_radius;
 public:
     VertexArray();
     ~VertexArray();
     void addVertex(v3 position, v2 texCoord, v3 normal);
     void addIndex(unsigned int ind);
     void setIndices(const std::vector<unsigned int>& indices);
-    void bind();
 
     // take all information and generate buffers for GL
     void build();
 
+    // point the attribs and element buffer of the currently bound vertex array object at this mesh
+    void setupAttribs();
+
+    // unique for the lifetime of the app, unlike the object's address
+    unsigned int getId();
+
     size_t getIndexCount();
+
+    // distance from the origin to the furthest vertex, set by build()
+    float getRadius();
+
+    // size of the vertex and index data uploaded by build()
+    size_t getByteSize();
 };
 
 namespace utils {
@@ -118,6 +250,12 @@ namespace utils {
     extern decltype(rs_getFrameImageData)* rsGetFrameImageData;
     extern decltype(rs_getFrameImage2)* rsGetFrameImage;
 
+    // point every rs function above at one that holds a single lock around the call,
+    // so calls from different threads are made one at a time. renderstream doesn't
+    // say it can be called from more than one. call it once they're bound, before
+    // a second thread uses them
+    void serialiseRsCalls();
+
     struct ShaderProgramSource {
         std::string vertexSource;
         std::string fragmentSource;
@@ -0,0 +1,77 @@
+#include "allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef RSTEST_COUNT_ALLOCS
+
+static std::atomic<size_t> s_count(0);
+
+void* operator new(size_t size)
+{
+    s_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    s_count.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+#endif
+
+namespace allocations {
+
+    size_t getCount()
+    {
+#ifdef RSTEST_COUNT_ALLOCS
+        return s_count.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+
+    bool isCounting()
+    {
+#ifdef RSTEST_COUNT_ALLOCS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+}
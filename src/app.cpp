@@ -1,13 +1,17 @@
 #include "app.hpp"
 
+#ifdef _WIN32
 #define GLFW_EXPOSE_NATIVE_WIN32
 #define GLFW_EXPOSE_NATIVE_WGL
+#endif
 
 #include <iostream>
+#ifdef _WIN32
 #include <shlwapi.h>
 #include <shlobj.h>
 #include <tchar.h>
 #include <GLFW/glfw3native.h>
+#endif
 #include <d3renderstream.h>
 #include <glm/glm.hpp>
 #include <imgui/imgui.h>
@@ -16,33 +20,64 @@
 #include <imgui/misc/cpp/imgui_stdlib.h>
 #include <fstream>
 #include <cmath>
+#include <cstring>
 
 #include "scene.hpp"
 #include "object.hpp"
 #include "utils.hpp"
+#include "mesh.hpp"
+#include "rendercontext.hpp"
+#include "renderworker.hpp"
+#include "allocations.hpp"
+#include "texturepool.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 #undef STB_IMAGE_IMPLEMENTATION
 
+#ifdef _MSC_VER
 #pragma warning(disable:4996)
+#endif
 
 App* App::s_instance = nullptr;
 
-App::App() : m_window		(nullptr),
-             m_currentScene	(nullptr),
-             m_rsLib		(nullptr),
-             m_header		(nullptr),
+App::App(const LaunchOptions& options)
+           : m_options      (options),
+             m_window		(nullptr),
+             m_uiWindow     (nullptr),
+             m_config       (options.config),
              m_windowWidth	(1920.f),
              m_windowHeight	(1080.f),
+             m_currentScene	(nullptr),
+             m_rsLib		(nullptr),
              m_frame        (),
-             m_schema       ()
+             m_schema       (),
+             m_header		(nullptr),
+             m_arrival      (nullptr),
+             m_arrived      (nullptr),
+             m_frameReady   (false),
+             m_context      (nullptr),
+             m_frameIndex   (0),
+             m_targetDepth  (0),
+             m_targetScaling (false),
+             m_lastUiTime   (0),
+             m_stateChanged (false),
+             m_allocsReported (false),
+             m_schemaEditDepth (0),
+             m_schemaDirty  (false),
+             m_profiler     (options.profileFrames)
 {
     s_instance = this;
+
+    m_schema.engineName = "RSTest";
+    m_schema.engineVersion = "0.1";
+    m_schema.pluginVersion = "0.1";
+    m_schema.info = "OpenGL test engine for RenderStream";
 }
 
 int App::loadRenderStream()
 {
+#ifdef _WIN32
     HKEY key;
     if (RegOpenKeyExA(HKEY_CURRENT_USER, "Software\\d3 Technologies\\d3 Production Suite", 0, KEY_READ, &key)) 
         return utils::error("failed to open d3 registry key! do you have the disguise software installed?");
@@ -84,11 +119,6 @@ int App::loadRenderStream()
     if (rs_initialise(RENDER_STREAM_VERSION_MAJOR, RENDER_STREAM_VERSION_MINOR))
         return utils::error("failed to init RenderStream!");
 
-    m_schema.engineName = "RSTest";
-    m_schema.engineVersion = "0.1";
-    m_schema.pluginVersion = "0.1";
-    m_schema.info = "OpenGL test engine for RenderStream";
-
     if (rs_setSchema(&m_schema))
         return utils::error("failed to set schema!");
 
@@ -105,140 +135,557 @@ int App::loadRenderStream()
     utils::rsGetFrameImage          = rs_getFrameImage2;
 
     return 0;
+#else
+    return utils::error("d3renderstream.dll can only be loaded on windows");
+#endif
+}
+
+void App::createTargets()
+{
+    // jobs point into the targets, and frames rendered for the old stream list aren't wanted
+    dropPending();
+
+    m_stateChanged = true;
+    m_targetDepth = m_config.frameQueueDepth;
+
+    const size_t nStreams = m_header ? m_header->nStreams : 0;
+    m_targetSamples.resize(nStreams);
+    for (size_t i = 0; i < nStreams; ++i)
+        m_targetSamples[i] = getStreamSamples(m_header->streams[i].handle);
+
+    m_targetScaling = m_config.dynamicResolution;
+
+    // contexts keep framebuffers by texture name, which a freed target's can be reused for
+    if (m_targets.update(m_header, m_targetDepth, m_targetSamples, m_targetScaling))
+    {
+        m_context->clearFramebuffers();
+        for (RenderWorker* worker : m_workers)
+            worker->invalidateTargets();
+    }
+}
+
+int App::getStreamSamples(StreamHandle handle)
+{
+    auto it = m_config.streamMsaa.find(handle);
+    return 1 << (it != m_config.streamMsaa.end() ? it->second : m_config.msaa);
+}
+
+void App::updateResolutionScale()
+{
+    if (!m_config.dynamicResolution)
+    {
+        m_scaler.reset();
+        return;
+    }
+
+    // what the last iteration spent producing its frame, waiting on d3 and drawing the ui aren't load
+    const size_t count = m_profiler.getCount();
+    if (!count)
+        return;
+    const FrameTiming& last = m_profiler.getFrame(count - 1);
+    if (last.frame < 0)
+        return;
+    const float frameMs = last.total - last.stages[Stage_Await] - last.stages[Stage_Ui];
+    if (!m_scaler.update(frameMs, (float)m_config.targetFps, m_config.minScale))
+        return;
+
+    // rare enough to log every change, operators want to know when streams went soft
+    m_stateChanged = true;
+    const float scale = m_scaler.getScale();
+    std::string msg = MSG(resolution scale );
+    msg += std::to_string((int)std::lround(scale * 100)) + "% after a " + std::to_string((int)std::lround(frameMs))
+        + " ms frame";
+    for (size_t i = 0; i < (m_header ? m_header->nStreams : 0); ++i)
+    {
+        const StreamDescription& desc = m_header->streams[i];
+        msg += std::string(i ? ", " : ": ") + desc.name + " " + std::to_string(std::max(1L, std::lround(desc.width * scale)))
+            + "x" + std::to_string(std::max(1L, std::lround(desc.height * scale)));
+    }
+    utils::logToD3(msg.c_str());
+}
+
+void App::destroyTargets()
+{
+    // nothing may still be rendering into or waiting to send these
+    dropPending();
+    m_targets.clear();
 }
 
 int App::handleStreams() 
 {
-    RS_ERROR err = utils::rsAwaitFrameData(5000, &m_frame);
+    RS_ERROR err;
+    if (m_arrival)
+    {
+        // with no frame waiting, only wait until the ui is due so it stays responsive
+        const double timeout = m_options.headless ? 5.0
+            : std::max(0.0, m_lastUiTime + 1.0 / m_config.uiRefreshRate - glfwGetTime());
+        m_arrived = m_arrival->take(timeout);
+        m_frameReady = m_arrived != nullptr;
+        if (!m_frameReady)
+            return 0;
+        if (!m_arrived->error.empty())
+            return utils::error(m_arrived->error);
+
+        err = m_arrived->status;
+        m_frame = m_arrived->frame;
+        m_frameReady = err == RS_ERROR_SUCCESS;
+    }
+    else
+    {
+        err = utils::rsAwaitFrameData(5000, &m_frame);
+        m_frameReady = true;
+    }
+
     switch (err) {
     case RS_ERROR_STREAMS_CHANGED:
+        m_stateChanged = true;
         try {
-            m_header = utils::getStreams(m_desc);
-            size_t nStreams = m_header ? m_header->nStreams : 0;
-            for (size_t i = 0; i < nStreams; ++i) {
-                const StreamDescription& desc = m_header->streams[i];
-                RenderTarget& target = m_targets[desc.handle];
-                glGenTextures(1, &target.texture);
-                utils::checkGLError(" generating tex");
-                glBindTexture(GL_TEXTURE_2D, target.texture);
-                utils::checkGLError(" binding texture");
-
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-
-                glTexImage2D(GL_TEXTURE_2D, 0, utils::glInternalFormat(desc.format), desc.width, desc.height, 
-                                            0, utils::glFormat(desc.format), utils::glType(desc.format), nullptr);
-
-                glBindTexture(GL_TEXTURE_2D, 0);
-
-                glGenFramebuffers(1, &target.frameBuf);
-                glBindFramebuffer(GL_FRAMEBUFFER, target.frameBuf);
-
-                unsigned int rbo;
-                glGenRenderbuffers(1, &rbo);
-                glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-                glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, desc.width, desc.height);
-                glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-                glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.texture, 0);
-
-                GLenum bufs[] = { GL_COLOR_ATTACHMENT0 };
-                glDrawBuffers(1, bufs);
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            if (m_arrival)
+            {
+                // the old list's buffer goes back to the thread for the next change
+                m_desc.swap(m_arrived->desc);
+                m_header = m_arrived->header;
             }
+            else m_header = utils::getStreams(m_desc);
+            createTargets();
         }
         catch (const std::exception& e) {
             return utils::error(e.what());
         }
     case RS_ERROR_TIMEOUT:
     case RS_ERROR_SUCCESS: return 0;
-    case RS_ERROR_QUIT: return 0;
+    case RS_ERROR_QUIT:
+        // d3 has stopped the workload, without this a headless instance would never exit
+        m_uiState.exit = true;
+        return 0;
     default:
         return utils::error("rs_awaitFrameData returned " + utils::rsErrorStr(err));
     }
 }
 
+void App::publishLayouts()
+{
+    if (!m_options.frameThread)
+        return;
+
+    const size_t count = std::min<size_t>(m_schema.scenes.nScenes, m_scenes.size());
+    m_layouts.resize(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const ParamLayout& layout = m_scenes[i]->getParamLayout();
+        m_layouts[i].hash = m_schema.scenes.scenes[i].hash;
+        m_layouts[i].numbers = layout.numbers;
+        m_layouts[i].images = layout.images;
+    }
+}
+
 int App::sendFrames() 
 {
     const size_t nStreams = m_header ? m_header->nStreams : 0;
+    if (!nStreams)
+        return 0;
+
+    if (m_frame.scene > m_scenes.size()) {
+        // scene is invalid, set it to 0.
+        utils::logToD3("got invalid scene, using default.");
+        m_frame.scene = 0;
+    }
+
+    if (m_currentScene != m_scenes[m_frame.scene])
+    {
+        m_currentScene = m_scenes[m_frame.scene];
+        m_stateChanged = true;
+    }
+
+    // Add and remove objects/scenes created in ui
+    if (!m_updateQueue.empty())
+    {
+        if (m_updateQueue.hasAddObject)
+            m_currentScene->addObject(m_updateQueue.addObject.type, m_updateQueue.addObject.args);
+
+        Object* const remObj = m_updateQueue.removeObject;
+        if (remObj)
+            m_currentScene->removeObject(remObj);
+
+        if (m_updateQueue.hasAddScene)
+            addScene(m_updateQueue.addScene.name);
+
+        m_updateQueue.clear();
+        m_stateChanged = true;
+    }
+
+    // the scene's hash below is only valid once d3 has its new parameters
+    flushSchema();
+
+    const RemoteParameters& rsScene = m_schema.scenes.scenes[m_frame.scene];
+    
+    // only number params are packed into the params array, image params are fetched separately
+    const ParamLayout& layout = m_currentScene->getParamLayout();
+
+    // fetched on the arrival thread with the layout d3 had then. a frame that came in
+    // before a scene or schema change is fetched again here, it's still the current one
+    const bool prefetched = m_arrival && m_arrived->hash == rsScene.hash
+        && m_arrived->images.size() == layout.images && m_arrived->params.size() == layout.numbers;
+    if (prefetched)
+    {
+        if (!m_arrived->imagesOk)
+            utils::logToD3(MSG(failed to get image param data));
+        if (!m_arrived->paramsOk)
+            return 0;
+
+        if (m_imgData.size() != layout.images || m_params.size() != layout.numbers)
+            m_stateChanged = true;
+        // the buffers go back to the thread, which fills them for a later frame
+        m_imgData.swap(m_arrived->images);
+        m_params.swap(m_arrived->params);
+    }
+    else
+    {
+        if (m_imgData.size() != layout.images)
+        {
+            m_imgData.resize(layout.images);
+            m_stateChanged = true;
+        }
+
+        {
+            ProfileScope scope(m_profiler, Stage_Images);
+            if (utils::rsGetFrameImageData(rsScene.hash, m_imgData.data(), m_imgData.size()))
+                utils::logToD3(MSG(failed to get image param data));
+        }
+
+        if (m_params.size() != layout.numbers)
+        {
+            m_params.resize(layout.numbers);
+            m_stateChanged = true;
+        }
+
+        // parameters are the same for every stream in a frame, so they
+        // are fetched and applied to the scene once
+        {
+            ProfileScope scope(m_profiler, Stage_Params);
+            if (utils::rsGetFrameParams(rsScene.hash, m_params.data(), m_params.size() * sizeof(float)))
+                return 0;
+        }
+    }
+
+    {
+        ProfileScope scope(m_profiler, Stage_Update);
+        m_currentScene->update();
+    }
+
+    // images were pulled in the update, the rest of the frame's renderstream calls can
+    // come after the next await, like sends of frames a deeper queue holds back. the
+    // thread awaits and fetches the next frame while this one renders and sends
+    if (m_arrival)
+        m_arrival->release(m_layouts);
+
+    updateResolutionScale();
+
+    // switching queue depth, msaa or resolution scaling needs new targets, send whatever used the old ones first
+    bool samplesChanged = false;
+    for (size_t i = 0; i < nStreams; ++i)
+        samplesChanged |= i >= m_targetSamples.size() || m_targetSamples[i] != getStreamSamples(m_header->streams[i].handle);
+
+    if (m_targetDepth != m_config.frameQueueDepth || samplesChanged || m_targetScaling != m_config.dynamicResolution)
+    {
+        if (flushFrames(0))
+            return 1;
+        createTargets();
+    }
+
+    // a slot is only reused after the frame that last used it has been sent
+    m_paramHistory.resize(m_targetDepth);
+    std::vector<float>& params = m_paramHistory[m_frameIndex % m_targetDepth];
+    params = m_params;
+
+    // gather cameras on the main thread, or take the ones the arrival thread
+    // fetched with the frame. renderstream calls stay off the workers
+    m_jobs.clear();
+    m_currentScene->getStore().setLodStreams(nStreams);
     for (size_t i = 0; i < nStreams; ++i) {
         const StreamDescription& desc = m_header->streams[i];
-        FrameResponseData response;
-        CameraResponseData cameraResponse;
-        cameraResponse.tTracked = m_frame.tTracked;
-        if (utils::rsGetFrameCamera(desc.handle, &cameraResponse.camera) == RS_ERROR_SUCCESS) {
-            const RenderTarget& target = m_targets.at(desc.handle);
-            setWindowWidth(desc.width);
-            setWindowHeight(desc.height);
-            glViewport(0, 0, desc.width, desc.height);
-            glBindFramebuffer(GL_FRAMEBUFFER, target.frameBuf);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-            if (m_frame.scene > m_scenes.size()) {
-                // scene is invalid, set it to 0.
-                utils::logToD3("got invalid scene, using default.");
-                m_frame.scene = 0;
+        StreamJob job;
+        job.cameraResponse.tTracked = m_frame.tTracked;
+        if (m_arrival)
+        {
+            if (i >= m_arrived->camerasOk.size() || !m_arrived->camerasOk[i])
+                continue;
+            job.cameraResponse.camera = m_arrived->cameras[i];
+        }
+        else if (utils::rsGetFrameCamera(desc.handle, &job.cameraResponse.camera) != RS_ERROR_SUCCESS)
+            continue;
+
+        setWindowWidth(desc.width);
+        setWindowHeight(desc.height);
+
+        const CameraData& camera = job.cameraResponse.camera;
+        Camera* cam = m_currentScene->getCurrentCamera();
+        cam->setPosition(glm::vec3(camera.z, -camera.y, camera.x));
+        cam->setRotation(camera.rz, camera.ry, camera.rx);
+
+        StreamTargets& targets = m_targets.get(desc.handle);
+
+        job.scene = m_currentScene;
+        job.handle = desc.handle;
+        job.frame = m_frameIndex;
+        job.schemaHash = rsScene.hash;
+        job.params = &params;
+        job.width = desc.width;
+        job.height = desc.height;
+        job.target = &targets.buffers[targets.next];
+        const float scale = m_targetScaling ? m_scaler.getScale() : 1.f;
+        job.renderWidth = std::max(1, (int)std::lround(desc.width * scale));
+        job.renderHeight = std::max(1, (int)std::lround(desc.height * scale));
+        // at full scale too, the target has nothing to draw into while scaling is on
+        job.scaled = m_targetScaling ? &targets.scaled[targets.next] : nullptr;
+        job.camera = m_currentScene->getCameraBlock();
+        job.fence = nullptr;
+        job.renderTime = 0;
+        job.stats = DrawStats();
+        job.stream = i;
+        job.source = -1;
+
+        // d3 can point several streams at the same camera, only differing in
+        // format or where the frames go. the first of them renders for the rest
+        if (m_config.shareRenders)
+        {
+            for (size_t j = 0; j < m_jobs.size(); ++j)
+            {
+                const StreamJob& other = m_jobs[j];
+                if (other.source < 0 && other.width == job.width && other.height == job.height
+                    && other.target->samples == job.target->samples && !memcmp(&other.camera, &job.camera, sizeof(job.camera)))
+                {
+                    job.source = j;
+                    break;
+                }
             }
+        }
+
+        m_jobs.push_back(job);
 
-            m_currentScene = &m_scenes[m_frame.scene];
+        targets.next = (targets.next + 1) % targets.buffers.size();
+    }
+
+    updateWorkers();
 
-            // Add and remove objects/scenes created in ui
-            if (!m_updateQueue.empty())
+    {
+        ProfileScope scope(m_profiler, Stage_Render);
+        if (!m_workers.empty())
+        {
+            renderParallel();
+        }
+        else
+        {
+            for (StreamJob& job : m_jobs)
             {
-                const ObjectConfig* const addObj = m_updateQueue.addObject;
-                if (addObj)
-                    m_currentScene->addObject(addObj->type, addObj->args);
+                if (job.source >= 0)
+                    continue;
+                m_context->render(job);
+                job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+        }
+        copySharedRenders();
+        glFlush();
+    }
 
-                Object* const remObj = m_updateQueue.removeObject;
-                if (remObj)
-                    m_currentScene->removeObject(remObj);
+    m_profiler.setFrame(m_frameIndex);
+    for (const StreamJob& job : m_jobs)
+        m_profiler.addStreamTime(job.frame, job.handle, Stream_Render, job.renderTime);
+    collectGpuTimes();
 
-                const SceneConfig* const addScene = m_updateQueue.addScene;
-                if (addScene)
-                    m_scenes.push_back(Scene(addScene->name));
+    m_pending.insert(m_pending.end(), m_jobs.begin(), m_jobs.end());
+    ++m_frameIndex;
 
-                m_updateQueue.clear();
-            }
+    return flushFrames(m_targetDepth - 1);
+}
 
-            const RemoteParameters& rsScene = m_schema.scenes.scenes[m_frame.scene];
-            
-            const int objCount = m_currentScene->getObjectCount();
+int App::flushFrames(int maxPending)
+{
+    ProfileScope scope(m_profiler, Stage_Send);
 
-            if (m_imgData.size() != objCount)
-                m_imgData.resize(objCount);
+    // long enough for any real frame, past it the gpu is taken to be lost
+    const GLuint64 timeout = 5000000000; // 5s in ns
 
-            if (utils::rsGetFrameImageData(rsScene.hash, m_imgData.data(), m_imgData.size()))
-                utils::logToD3(MSG(failed to get image param data));
+    // sent jobs are erased in one go afterwards, popping them one by one from
+    // the front would shift the rest every time
+    size_t sent = 0;
+    int result = 0;
+    while (sent < m_pending.size())
+    {
+        const StreamJob& job = m_pending[sent];
+        const int queued = m_pending.back().frame - job.frame + 1;
 
-            if (m_params.size() != rsScene.nParameters)
-                m_params.resize(rsScene.nParameters);
+        // jobs without a fence were never rendered
+        if (!job.fence)
+        {
+            ++sent;
+            continue;
+        }
 
-            if (utils::rsGetFrameParams(rsScene.hash, m_params.data(), (m_params.size() - objCount) * sizeof(float)))
-                continue;
+        // frames beyond the allowed depth are waited for, the rest are
+        // only sent if the gpu has already finished them
+        GLenum status;
+        if (queued > maxPending)
+        {
+            // the next frame renders into this one's target, it can't be skipped
+            status = glClientWaitSync(job.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        }
+        else
+        {
+            status = glClientWaitSync(job.fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED)
+                break;
+        }
+
+        glDeleteSync(job.fence);
+        ++sent;
 
-            Camera* cam = m_currentScene->getCurrentCamera();
-            cam->setPosition(glm::vec3(cameraResponse.camera.z, -cameraResponse.camera.y, cameraResponse.camera.x));
-            cam->setRotation(cameraResponse.camera.rz, cameraResponse.camera.ry, cameraResponse.camera.rx);
-            m_currentScene->render();
-            SenderFrame data;
-            data.type = RS_FRAMETYPE_OPENGL_TEXTURE;
-            data.gl.texture = target.texture;
-            response.schemaHash = rsScene.hash;
-            response.cameraData = &cameraResponse;
-            response.parameterData = m_params.data();
-            response.parameterDataSize = m_params.size() * sizeof(float);
-            response.textData = nullptr;
-            response.textDataCount = 0;
-            if (utils::rsSendFrame(desc.handle, &data, &response))
-                return 1;
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            // the wait failed or timed out, nothing says the frame is finished so it
+            // isn't sent. finishing makes sure the target is free before it's rendered into again
+            utils::logToD3(MSG(a frame never finished on the gpu so it was dropped));
+            glFinish();
+            continue;
+        }
+
+        const double start = glfwGetTime();
+        if (submitFrame(job))
+        {
+            result = 1;
+            break;
         }
+        m_profiler.addStreamTime(job.frame, job.handle, Stream_Send, (glfwGetTime() - start) * 1000.0);
     }
-    return 0;
+    m_pending.erase(m_pending.begin(), m_pending.begin() + sent);
+
+    m_metrics.framesInFlight = m_pending.empty() ? 0 : m_pending.back().frame - m_pending.front().frame + 1;
+    return result;
+}
+
+void App::dropPending()
+{
+    for (const StreamJob& job : m_pending)
+        if (job.fence)
+            glDeleteSync(job.fence);
+    m_pending.clear();
+    m_metrics.framesInFlight = 0;
+}
+
+void App::updateWorkers()
+{
+    const size_t count = m_config.parallelStreams ? m_config.renderWorkers : 0;
+    if (m_workers.size() == count)
+        return;
+
+    m_stateChanged = true;
+
+    for (RenderWorker* worker : m_workers)
+        delete worker;
+    m_workers.clear();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        RenderWorker* worker = new RenderWorker(m_window);
+        m_workers.push_back(worker);
+        if (worker->isRunning())
+            continue;
+
+        // a job dealt to it would never be rendered or fenced, so every stream
+        // goes back to the main context until parallel streams are turned on again
+        utils::logToD3(MSG(a render worker failed to start so streams render on the main thread));
+        for (RenderWorker* created : m_workers)
+            delete created;
+        m_workers.clear();
+        m_config.parallelStreams = false;
+        break;
+    }
+}
+
+void App::renderParallel()
+{
+    // workers must not sample textures or meshes before the main context's
+    // uploads for this frame have executed
+    GLsync updateFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    // streams are always dealt out in the same order, so each worker keeps
+    // rendering (and holding framebuffers for) the same streams
+    for (RenderWorker* worker : m_workers)
+        worker->clearJobs();
+    size_t dealt = 0;
+    for (StreamJob& job : m_jobs)
+        if (job.source < 0)
+            m_workers[dealt++ % m_workers.size()]->addJob(&job);
+
+    for (RenderWorker* worker : m_workers)
+        worker->start(updateFence);
+    for (RenderWorker* worker : m_workers)
+        worker->wait();
+
+    glDeleteSync(updateFence);
+}
+
+void App::copySharedRenders()
+{
+    m_metrics.rendersSaved = 0;
+
+    for (StreamJob& job : m_jobs)
+    {
+        if (job.source < 0)
+            continue;
+
+        const double start = glfwGetTime();
+        const StreamJob& source = m_jobs[job.source];
+
+        // the source may have been rendered on a worker's context
+        glWaitSync(source.fence, 0, GL_TIMEOUT_IGNORED);
+
+        // stream targets' framebuffers belong to the main context. blitting
+        // converts between formats, so the streams only have to match in size.
+        // multisampled targets are copied from and into their resolved texture
+        const RenderTarget& from = *source.target;
+        const RenderTarget& to = *job.target;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, from.resolveBuf ? from.resolveBuf : from.frameBuf);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, to.resolveBuf ? to.resolveBuf : to.frameBuf);
+        glBlitFramebuffer(0, 0, job.width, job.height, 0, 0, job.width, job.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        job.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        job.renderTime = (glfwGetTime() - start) * 1000.0;
+        m_metrics.rendersSaved++;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void App::collectGpuTimes()
+{
+    m_gpuTimes.clear();
+    m_context->collectGpuTimes(m_gpuTimes);
+    for (RenderWorker* worker : m_workers)
+    {
+        const std::vector<GpuTiming>& times = worker->getGpuTimes();
+        m_gpuTimes.insert(m_gpuTimes.end(), times.begin(), times.end());
+    }
+
+    for (const GpuTiming& timing : m_gpuTimes)
+        m_profiler.addStreamTime(timing.frame, timing.handle, timing.stat, timing.ms);
+}
+
+int App::submitFrame(const StreamJob& job)
+{
+    SenderFrame data;
+    data.type = RS_FRAMETYPE_OPENGL_TEXTURE;
+    data.gl.texture = job.target->texture;
+
+    FrameResponseData response;
+    response.schemaHash = job.schemaHash;
+    response.cameraData = &job.cameraResponse;
+    response.parameterData = job.params->data();
+    response.parameterDataSize = job.params->size() * sizeof(float);
+    response.textData = nullptr;
+    response.textDataCount = 0;
+    return utils::rsSendFrame(job.handle, &data, &response);
 }
 
 void App::measureFps()
@@ -254,6 +701,35 @@ void App::measureFps()
     }
 }
 
+void App::measureAllocations(size_t allocsBefore)
+{
+    if (!allocations::isCounting())
+        return;
+
+    // the first few iterations after a change still grow vectors and fill
+    // caches, gpu timings for instance only come back a couple of frames later
+    const int settleFrames = 8;
+
+    m_metrics.frameAllocations = allocations::getCount() - allocsBefore;
+
+    if (m_stateChanged)
+    {
+        m_metrics.steadyFrames = 0;
+        m_allocsReported = false;
+        m_stateChanged = false;
+        return;
+    }
+
+    // only report the first offending frame after each change so d3's log isn't flooded
+    if (++m_metrics.steadyFrames > settleFrames && m_metrics.frameAllocations && !m_allocsReported)
+    {
+        std::string msg = MSG(heap allocations in steady state frame: );
+        msg += std::to_string(m_metrics.frameAllocations);
+        utils::logToD3(msg.c_str());
+        m_allocsReported = true;
+    }
+}
+
 void App::renderUi()
 {
     // switch context to window for ui rendering
@@ -276,18 +752,129 @@ void App::renderUi()
     // we don't want the imgui windows to be resized or moved
     const int flags = ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove;
     ImGui::Begin("Metrics", 0, flags);
-    ImGui::LabelText(std::to_string(m_metrics.fps).c_str(), "FPS");
+    ImGui::LabelText("FPS", "%.0f", m_metrics.fps);
+    if (allocations::isCounting())
+        ImGui::LabelText("Allocations / frame", "%d", (int)m_metrics.frameAllocations);
+    ImGui::LabelText("Frames in flight", "%d / %d", m_metrics.framesInFlight, m_targetDepth);
+    ImGui::LabelText("Stream targets", "%d (%.1f MB), last change made %d, freed %d, kept %d", m_targets.getTargetCount(),
+        m_targets.getBytes() / (1024.f * 1024.f), m_targets.getMade(), m_targets.getFreed(), m_targets.getKept());
+    ImGui::LabelText("Schema uploads", "%d", m_metrics.schemaUploads);
+    ImGui::LabelText("Meshes", "%d (%.1f KB, %.1f KB saved)", MeshRegistry::getMeshCount(),
+        MeshRegistry::getBytesUsed() / 1024.f, MeshRegistry::getBytesSaved() / 1024.f);
+    ImGui::LabelText("Textures", "%d / %d in use (%.1f MB)", TexturePool::getUsedCount(),
+        TexturePool::getTotalCount(), TexturePool::getBytes() / (1024.f * 1024.f));
+    ImGui::LabelText("Image fetches", "%d (%d shared)", m_currentScene->getImageFetches(),
+        m_currentScene->getImageFetchesSaved());
+    const int objCount = m_currentScene->getObjectCount();
+    ImGui::LabelText("Transforms rebuilt", "%d / %d (%.0f%% skipped, %s)", m_currentScene->getTransformsUpdated(), objCount,
+        objCount ? 100.f * (objCount - m_currentScene->getTransformsUpdated()) / objCount : 0.f,
+        transforms::getKernelName(m_currentScene->getTransformKernel()));
+
+    // jobs of the last rendered frame, streams without a camera didn't get one
+    int triangles = 0;
+    int fullTriangles = 0;
+    for (const StreamJob& job : m_jobs)
+    {
+        triangles += job.stats.triangles;
+        fullTriangles += job.stats.fullTriangles;
+    }
+    ImGui::LabelText("Triangles", "%d (%d without LOD)", triangles, fullTriangles);
+    ImGui::LabelText("Renders saved", "%d / %d streams", m_metrics.rendersSaved, (int)m_jobs.size());
+
+    if (ImGui::CollapsingHeader("Streams (drawn / culled objects, triangles, render size)"))
+    {
+        for (const StreamJob& job : m_jobs)
+            for (size_t i = 0; i < (m_header ? m_header->nStreams : 0); ++i)
+                if (m_header->streams[i].handle == job.handle)
+                    ImGui::LabelText(m_header->streams[i].name, "%d / %d, %d, %ux%u (%.0f%%)", job.stats.drawn,
+                        job.stats.culled, job.stats.triangles, job.renderWidth, job.renderHeight,
+                        100.f * job.renderWidth / job.width);
+    }
+
+    if (ImGui::CollapsingHeader("Parameter strings"))
+    {
+        for (Scene* scene : m_scenes)
+            ImGui::LabelText(scene->getName(), "%.1f KB (%.1f KB saved)",
+                scene->getParamBytes() / 1024.f, scene->getParamBytesSaved() / 1024.f);
+    }
+
+    if (ImGui::CollapsingHeader("Frame timing (min / avg / p99 ms)"))
+    {
+        for (int i = 0; i <= Stage_Count; ++i)
+        {
+            const TimingStats stats = m_profiler.getStats(i);
+            ImGui::LabelText(Profiler::getStageName(i), "%.2f / %.2f / %.2f", stats.min, stats.avg, stats.p99);
+        }
+
+        // frame time of every iteration in the ring, oldest on the left
+        auto getTotal = [](void* data, int i) {
+            return ((Profiler*)data)->getFrame(i).total;
+        };
+        ImGui::PlotLines("Frame time", getTotal, &m_profiler, m_profiler.getCount());
+
+        for (size_t i = 0; i < (m_header ? m_header->nStreams : 0); ++i)
+        {
+            const StreamHandle handle = m_header->streams[i].handle;
+            const TimingStats render = m_profiler.getStreamStats(handle, Stream_Render);
+            const TimingStats gpu = m_profiler.getStreamStats(handle, Stream_Gpu);
+            const TimingStats resolve = m_profiler.getStreamStats(handle, Stream_Resolve);
+            const TimingStats upscale = m_profiler.getStreamStats(handle, Stream_Upscale);
+            const TimingStats send = m_profiler.getStreamStats(handle, Stream_Send);
+            ImGui::LabelText(m_header->streams[i].name, "cpu %.2f, gpu %.2f, resolve %.2f, upscale %.2f, send %.2f avg",
+                render.avg, gpu.avg, resolve.avg, upscale.avg, send.avg);
+        }
+
+        if (ImGui::Button("Dump timings to csv"))
+        {
+            if (m_profiler.writeCsv("frame_timings.csv"))
+                utils::logToD3("wrote frame_timings.csv");
+            else utils::logToD3(MSG(failed to write frame timings));
+        }
+    }
     ImGui::End();
     ImGui::SetNextWindowSize(ImVec2(winX, winHalfY));
     ImGui::SetNextWindowPos(ImVec2(0, winHalfY));
     ImGui::Begin("Controls", 0, flags);
     ImGui::Combo("Colour Space", (int*) &m_config.colourSpace, colourSpaces, IM_ARRAYSIZE(colourSpaces));
+    ImGui::Checkbox("Instanced rendering", &m_config.instancing);
+    ImGui::Checkbox("Frustum culling", &m_config.culling);
+    ImGui::Checkbox("Share renders between streams", &m_config.shareRenders);
+    ImGui::Checkbox("Sphere LOD", &m_config.lod);
+    if (m_config.lod)
+        ImGui::SliderFloat("LOD hysteresis", &m_config.lodHysteresis, 0.f, .5f);
+    ImGui::Checkbox("Parallel streams", &m_config.parallelStreams);
+    if (m_config.parallelStreams)
+        ImGui::SliderInt("Render threads", &m_config.renderWorkers, 1, 8);
+    ImGui::SliderInt("UI refresh rate", &m_config.uiRefreshRate, 5, 60);
+    ImGui::SliderInt("Frame queue depth", &m_config.frameQueueDepth, 1, 3);
+    ImGui::Combo("MSAA", &m_config.msaa, msaaModes, IM_ARRAYSIZE(msaaModes));
+    ImGui::Checkbox("Dynamic resolution", &m_config.dynamicResolution);
+    if (m_config.dynamicResolution)
+    {
+        ImGui::SliderInt("Target fps", &m_config.targetFps, 24, 120);
+        ImGui::SliderFloat("Minimum scale", &m_config.minScale, .25f, 1.f);
+    }
+
+    if (ImGui::CollapsingHeader("MSAA per stream"))
+    {
+        for (size_t i = 0; i < (m_header ? m_header->nStreams : 0); ++i)
+        {
+            // 0 follows the default above, the rest are msaaModes shifted by one
+            const StreamDescription& desc = m_header->streams[i];
+            auto it = m_config.streamMsaa.find(desc.handle);
+            int mode = it != m_config.streamMsaa.end() ? it->second + 1 : 0;
+            if (ImGui::Combo(desc.name, &mode, "Default\0Off\0" "2x\0" "4x\0" "8x\0\0"))
+            {
+                if (mode)
+                    m_config.streamMsaa[desc.handle] = mode - 1;
+                else m_config.streamMsaa.erase(desc.handle);
+            }
+        }
+    }
 
     if (ImGui::Button("Add object"))
         m_uiState.addObjectWinOpen = true;
 
-    const int objCount = m_currentScene->getObjectCount();
-
     // Only show remove object options if there are objects in scene
     if (objCount)
     {
@@ -297,14 +884,16 @@ void App::renderUi()
         // Window for removing object
         if (m_uiState.remObjectWinOpen)
         {
-            std::vector<const char*> objNames;
-            for (Object* obj : m_currentScene->getObjects())
-                objNames.push_back(obj->getName());
+            // names are read straight from the scene rather than gathered into a list
+            auto getName = [](void* data, int i, const char** name) {
+                *name = (*(Scene*)data)[i]->getName();
+                return true;
+            };
 
             ImGui::SetNextWindowSize(ImVec2(winX, winHalfY));
             ImGui::SetNextWindowPos(ImVec2(0, winHalfY));
             ImGui::Begin("Remove object", 0, flags | ImGuiWindowFlags_NoCollapse);
-            ImGui::Combo("Object", &m_uiState.currentRemObj, objNames.data(), objCount);
+            ImGui::Combo("Object", &m_uiState.currentRemObj, getName, m_currentScene, objCount);
             if (ImGui::Button("Remove"))
             {
                 Object* obj = (*m_currentScene)[m_uiState.currentRemObj];
@@ -336,7 +925,8 @@ void App::renderUi()
         if (ImGui::Button("Add"))
         {
             m_uiState.addObjectWinOpen = false;
-            m_updateQueue.addObject = new ObjectConfig(obj);
+            m_updateQueue.addObject = obj;
+            m_updateQueue.hasAddObject = true;
         }
         if (ImGui::Button("Close"))
             m_uiState.addObjectWinOpen = false;
@@ -354,7 +944,8 @@ void App::renderUi()
         if (ImGui::Button("Create"))
         {
             m_uiState.newSceneWinOpen = false;
-            m_updateQueue.addScene = new SceneConfig(scene);
+            m_updateQueue.addScene = scene;
+            m_updateQueue.hasAddScene = true;
             scene = SceneConfig();
         }
         if (ImGui::Button("Close"))
@@ -368,6 +959,9 @@ void App::renderUi()
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
     glfwSwapBuffers(m_uiWindow);
+
+    // back to the stream context for the next frame
+    glfwMakeContextCurrent(m_window);
 }
 
 App* App::getInstance() 
@@ -395,85 +989,151 @@ Scene* App::getCurrentScene()
     return s_instance->m_currentScene;
 }
 
+const Config& App::getConfig()
+{
+    return s_instance->m_config;
+}
+
 void App::reloadSchema()
 {
-    if (utils::rsSetSchema(&s_instance->m_schema))
-        utils::error("failed to reload schema");
+    s_instance->m_schemaDirty = true;
+}
+
+int App::flushSchema()
+{
+    App* app = s_instance;
+    if (!app->m_schemaDirty)
+        return 0;
+
+    app->m_schemaDirty = false;
+    app->m_metrics.schemaUploads++;
+    if (utils::rsSetSchema(&app->m_schema))
+        return utils::error("failed to reload schema");
+    // d3 hashes the scenes as it takes the schema
+    app->publishLayouts();
+    return 0;
+}
+
+void App::beginSchemaEdit()
+{
+    s_instance->m_schemaEditDepth++;
+}
+
+void App::endSchemaEdit()
+{
+    if (--s_instance->m_schemaEditDepth == 0)
+        flushSchema();
 }
 
 int App::run() 
 {
-    if (loadRenderStream())
+    if (m_options.loadRenderStream && loadRenderStream())
         return 1;
 
+    // without a display there is no window system to create contexts with
+    if (m_options.offscreen)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+
     // initialise glfw lib
     if (!glfwInit())
         return utils::error("failed to initialise GLFW!");
 
+    // worker windows are created with the same hints, so they get osmesa contexts too
+    if (m_options.offscreen)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+
     // create window and return if failed
     m_window = glfwCreateWindow(m_windowWidth, m_windowHeight, "RsTest", NULL, NULL);
     if (!m_window)
-        utils::error("failed to create window :(");
-
-    // create window for metrics and controls
-    const int dispW = glfwGetVideoMode(glfwGetPrimaryMonitor())->width;
-    const int dispH = glfwGetVideoMode(glfwGetPrimaryMonitor())->height;
-    
-    const int minW = dispW * .16;
-    const int minH = dispH * .28;
-    const int maxW = minW * 2;
-    const int maxH = minH * 2;
+        return utils::error("failed to create window :(");
 
-    m_uiWindow = glfwCreateWindow(minW, minH, "RsTest", NULL, NULL);
-    if (!m_uiWindow)
-        utils::error("failed to create ui window :(");
-    glfwSetWindowSizeLimits(m_uiWindow, minW, minH, maxW, maxH);
-
-    // find documents folder, where icon for ui window should be stored
-    char path[MAX_PATH];
-    HRESULT res = SHGetFolderPathA(NULL, CSIDL_MYDOCUMENTS, NULL, SHGFP_TYPE_CURRENT, path);
-    if (res == S_OK)
+    if (!m_options.headless)
     {
-        PathAppendA(path, "RsTest\\img\\icon.png");
+        // create window for metrics and controls
+        const int dispW = glfwGetVideoMode(glfwGetPrimaryMonitor())->width;
+        const int dispH = glfwGetVideoMode(glfwGetPrimaryMonitor())->height;
+
+        const int minW = dispW * .16;
+        const int minH = dispH * .28;
+        const int maxW = minW * 2;
+        const int maxH = minH * 2;
+
+        m_uiWindow = glfwCreateWindow(minW, minH, "RsTest", NULL, NULL);
+        if (!m_uiWindow)
+            utils::error("failed to create ui window :(");
+        glfwSetWindowSizeLimits(m_uiWindow, minW, minH, maxW, maxH);
+
+#ifdef _WIN32
+        // find documents folder, where icon for ui window should be stored
+        char path[MAX_PATH];
+        HRESULT res = SHGetFolderPathA(NULL, CSIDL_MYDOCUMENTS, NULL, SHGFP_TYPE_CURRENT, path);
+        if (res == S_OK)
+        {
+            PathAppendA(path, "RsTest\\img\\icon.png");
 
-        utils::logToD3(path);
+            utils::logToD3(path);
+
+            GLFWimage img;
+            img.pixels = stbi_load(path, &img.width, &img.height, 0, 4);
+            glfwSetWindowIcon(m_uiWindow, 1, &img);
+            stbi_image_free(img.pixels);
+        }
+        else utils::logToD3(MSG(could not find my program folder... did you get me from the installer?));
+#endif
 
-        GLFWimage img;
-        img.pixels = stbi_load(path, &img.width, &img.height, 0, 4);
-        glfwSetWindowIcon(m_uiWindow, 1, &img);
-        stbi_image_free(img.pixels);
+        // the ui is redrawn at its own rate, so don't let vsync on its
+        // swap chain hold up the stream loop
+        glfwMakeContextCurrent(m_uiWindow);
+        glfwSwapInterval(0);
     }
-    else utils::logToD3(MSG(could not find my program folder... did you get me from the installer?));
 
     // hide window and set it to be current opengl context
     glfwHideWindow(m_window);
     glfwMakeContextCurrent(m_window);
 
-    // set up imgui for metrics window
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGui_ImplGlfw_InitForOpenGL(m_uiWindow, true);
-    ImGui_ImplOpenGL3_Init("#version 120");
-    ImGui::StyleColorsDark();
-    ImGui::SetNextWindowSize(ImVec2(300, 250));
+    if (!m_options.headless)
+    {
+        // set up imgui for metrics window
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGui_ImplGlfw_InitForOpenGL(m_uiWindow, true);
+        ImGui_ImplOpenGL3_Init("#version 120");
+        ImGui::StyleColorsDark();
+        ImGui::SetNextWindowSize(ImVec2(300, 250));
+    }
 
     // initialise glew library, used to get openGL functions
     glewExperimental = GL_TRUE;
     glewInit();
 
-    // enable gl depth testing and set to draw when the incoming depth value is less than the stored depth value
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-
+#ifdef _WIN32
     HGLRC wglContext = glfwGetWGLContext(m_window);
     HDC dc = GetDC(glfwGetWin32Window(m_window));
+#else
+    // only the stub renderstream runs here, it doesn't use the handles
+    HGLRC wglContext = nullptr;
+    HDC dc = nullptr;
+#endif
 
     if(utils::rsInitialiseGpuOpenGl(wglContext, dc))
         utils::error("failed to initialise RenderStream GPU interop");
 
-    m_scenes.push_back(Scene("scene 1"));
-    m_currentScene = &m_scenes[0];
+    m_context = new RenderContext(m_window);
+
+    m_currentScene = addScene("scene 1");
+
+    if (m_options.setup)
+        m_options.setup(*this);
    
+    // the thread needs the scenes' hashes, which d3 only gives out with the schema
+    flushSchema();
+    if (m_options.frameThread)
+    {
+        utils::serialiseRsCalls();
+        publishLayouts();
+        m_arrival = new FrameArrival(m_layouts);
+    }
+
     m_frameInfo = FrameInfo(glfwGetTime());
 
     while(true)
@@ -481,24 +1141,74 @@ int App::run()
         if (m_uiState.exit)
             break;
 
-        glfwMakeContextCurrent(m_window);
+        m_profiler.beginFrame();
+        const size_t allocsBefore = allocations::getCount();
 
         measureFps();
 
-        if(handleStreams())
-            break;
+        // edits made outside a frame (setup, or while there are no streams)
+        flushSchema();
+
+        {
+            ProfileScope scope(m_profiler, Stage_Await);
+            if(handleStreams())
+                break;
+        }
 
-        if (sendFrames())
+        if (m_frameReady && sendFrames())
             break;
 
-        renderUi();
+        // frames that were dropped or never got to their update are released here
+        if (m_arrival)
+            m_arrival->release(m_layouts);
+
+        // the ui only needs to be readable, redrawing it every stream
+        // frame would cost a context switch and a swap each time
+        const double now = glfwGetTime();
+        if (!m_options.headless && now - m_lastUiTime >= 1.0 / m_config.uiRefreshRate)
+        {
+            m_lastUiTime = now;
+            ProfileScope scope(m_profiler, Stage_Ui);
+            renderUi();
+        }
 
         glfwPollEvents();
+
+        measureAllocations(allocsBefore);
+        m_profiler.endFrame();
     }
 
+    delete m_arrival;
+    m_arrival = nullptr;
+    m_arrived = nullptr;
+    for (RenderWorker* worker : m_workers)
+        delete worker;
+    m_workers.clear();
+    destroyTargets();
+    // objects give back their meshes and textures, which needs the context
+    for (Scene* scene : m_scenes)
+        delete scene;
+    m_scenes.clear();
+    m_currentScene = nullptr;
+    // the main context is current again after the ui, its objects go with it
+    delete m_context;
+    m_context = nullptr;
+
     return utils::rsShutdown();
 }
 
+Scene* App::addScene(const std::string& name)
+{
+    Scene* scene = new Scene(name);
+    m_scenes.push_back(scene);
+    return scene;
+}
+
+Profiler& App::getProfiler()
+{
+    return m_profiler;
+}
+
 float App::getWindowWidth() 
 {
     return m_windowWidth;
@@ -0,0 +1,166 @@
+#include "framearrival.hpp"
+
+#include <chrono>
+
+#include "utils.hpp"
+
+// renderstream calls are serialised, so the await is cut into slices. a main thread
+// call waits at most one of them for its turn
+static const int AWAIT_SLICE_MS = 1;
+
+FrameArrival::FrameArrival(const std::vector<SceneLayout>& layouts)
+    : m_published       (0),
+      m_released        (0),
+      m_taken           (0),
+      m_quit            (false),
+      m_takerParked     (false),
+      m_threadParked    (false),
+      m_layouts         (layouts)
+{
+    m_thread = std::thread(&FrameArrival::run, this);
+}
+
+FrameArrival::~FrameArrival()
+{
+    m_quit = true;
+    {
+        std::lock_guard<std::mutex> lock(m_parkMutex);
+        m_parkCv.notify_all();
+    }
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+template <typename Ready>
+bool FrameArrival::park(std::atomic<bool>& parked, Ready ready, double timeout)
+{
+    std::unique_lock<std::mutex> lock(m_parkMutex);
+    parked.store(true, std::memory_order_relaxed);
+    // pairs with the fence in wake(). either this sees the other side's count, or
+    // the other side sees it parked and takes the mutex to wake it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const bool result = m_parkCv.wait_for(lock, std::chrono::duration<double>(timeout), ready);
+    parked.store(false, std::memory_order_relaxed);
+    return result;
+}
+
+void FrameArrival::wake(std::atomic<bool>& parked)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!parked.load(std::memory_order_relaxed))
+        return;
+
+    std::lock_guard<std::mutex> lock(m_parkMutex);
+    m_parkCv.notify_all();
+}
+
+ArrivedFrame* FrameArrival::take(double timeout)
+{
+    // a frame that was dropped before it was released
+    if (m_released.load(std::memory_order_relaxed) != m_taken)
+    {
+        m_released.store(m_taken, std::memory_order_release);
+        wake(m_threadParked);
+    }
+
+    auto arrived = [this] { return m_published.load(std::memory_order_acquire) > m_taken; };
+    if (!arrived() && !park(m_takerParked, arrived, timeout))
+        return nullptr;
+
+    return &m_frames[m_taken++ % 2];
+}
+
+void FrameArrival::release(const std::vector<SceneLayout>& layouts)
+{
+    if (m_released.load(std::memory_order_relaxed) == m_taken)
+        return;
+
+    // the thread doesn't read these until it sees the store below
+    m_layouts.assign(layouts.begin(), layouts.end());
+
+    m_released.store(m_taken, std::memory_order_release);
+    wake(m_threadParked);
+}
+
+void FrameArrival::run()
+{
+    while (!m_quit)
+    {
+        // only this thread writes the count. the buffer it's about to fill was
+        // done with by the taker once it released every frame published so far
+        const uint64_t published = m_published.load(std::memory_order_relaxed);
+        auto released = [this, published] {
+            return m_released.load(std::memory_order_acquire) == published || m_quit;
+        };
+        if (!released())
+        {
+            // woken by release(), the timeout only bounds how long a quit goes unnoticed
+            park(m_threadParked, released, 0.5);
+            continue;
+        }
+
+        ArrivedFrame& out = m_frames[published % 2];
+        receive(out);
+        if (out.status == RS_ERROR_TIMEOUT)
+            continue;
+
+        m_published.store(published + 1, std::memory_order_release);
+        wake(m_takerParked);
+
+        // nothing comes after quit or an error, what to do about them is up to the taker
+        if (out.status != RS_ERROR_SUCCESS && out.status != RS_ERROR_STREAMS_CHANGED)
+            break;
+    }
+}
+
+void FrameArrival::receive(ArrivedFrame& out)
+{
+    out.error.clear();
+    out.header = nullptr;
+    out.paramsOk = false;
+    out.imagesOk = false;
+    out.hash = 0;
+
+    out.status = utils::rsAwaitFrameData(AWAIT_SLICE_MS, &out.frame);
+
+    if (out.status == RS_ERROR_STREAMS_CHANGED)
+    {
+        // there's no frame with a stream change, only the new list
+        try {
+            out.header = utils::getStreams(out.desc);
+        }
+        catch (const std::exception& e) {
+            out.status = RS_ERROR_UNSPECIFIED;
+            out.error = e.what();
+            return;
+        }
+
+        m_handles.resize(out.header->nStreams);
+        for (size_t i = 0; i < m_handles.size(); ++i)
+            m_handles[i] = out.header->streams[i].handle;
+        return;
+    }
+
+    if (out.status != RS_ERROR_SUCCESS)
+        return;
+
+    out.cameras.resize(m_handles.size());
+    out.camerasOk.resize(m_handles.size());
+    for (size_t i = 0; i < m_handles.size(); ++i)
+        out.camerasOk[i] = utils::rsGetFrameCamera(m_handles[i], &out.cameras[i]) == RS_ERROR_SUCCESS;
+
+    // the main thread may have changed the schema since these were set, it
+    // checks the hash and sizes against its own and fetches again if they differ
+    if (out.frame.scene < m_layouts.size())
+    {
+        const SceneLayout& layout = m_layouts[out.frame.scene];
+        out.hash = layout.hash;
+
+        out.images.resize(layout.images);
+        out.imagesOk = utils::rsGetFrameImageData(layout.hash, out.images.data(), out.images.size()) == RS_ERROR_SUCCESS;
+
+        out.params.resize(layout.numbers);
+        out.paramsOk = utils::rsGetFrameParams(layout.hash, out.params.data(), out.params.size() * sizeof(float)) == RS_ERROR_SUCCESS;
+    }
+}
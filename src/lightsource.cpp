@@ -9,11 +9,10 @@ LightSource::LightSource(glm::vec3 position, float brightness, float ambientStre
     m_obj               (obj)
 {}
 
-void LightSource::render() 
+void LightSource::render(RenderContext& ctx) 
 {
     if (m_obj != nullptr) {
-        m_obj->update();
-        m_obj->draw();
+        m_obj->draw(ctx);
     }
 }
 
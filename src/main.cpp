@@ -1,6 +1,13 @@
 #include "app.hpp"
 
-int main() {
-	App app;
+#include <cstring>
+
+int main(int argc, char* argv[]) {
+	LaunchOptions options;
+	for (int i = 1; i < argc; ++i)
+		if (!strcmp(argv[i], "--headless"))
+			options.headless = true;
+
+	App app(options);
 	return app.run();
 }
\ No newline at end of file
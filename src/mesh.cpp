@@ -0,0 +1,82 @@
+#include "mesh.hpp"
+
+std::map<MeshKey, MeshRegistry::Entry> MeshRegistry::s_meshes;
+std::unordered_set<unsigned int> MeshRegistry::s_ids;
+int MeshRegistry::s_freed = 0;
+
+VertexArray* MeshRegistry::acquire(const MeshKey& key, MeshBuilder build)
+{
+    Entry& entry = s_meshes[key];
+    if (!entry.mesh)
+    {
+        entry.mesh = new VertexArray();
+        entry.refs = 0;
+        build(*entry.mesh, key);
+        entry.mesh->build();
+        s_ids.insert(entry.mesh->getId());
+    }
+    ++entry.refs;
+    return entry.mesh;
+}
+
+void MeshRegistry::release(const MeshKey& key)
+{
+    auto it = s_meshes.find(key);
+    if (it == s_meshes.end())
+        return;
+
+    if (--it->second.refs > 0)
+        return;
+
+    s_ids.erase(it->second.mesh->getId());
+    delete it->second.mesh;
+    s_meshes.erase(it);
+    ++s_freed;
+}
+
+void MeshRegistry::acquire(MeshLods& lods, MeshBuilder build)
+{
+    for (int i = 0; i < lods.count; ++i)
+        lods.meshes[i] = acquire(lods.keys[i], build);
+}
+
+void MeshRegistry::release(MeshLods& lods)
+{
+    for (int i = 0; i < lods.count; ++i)
+    {
+        if (lods.meshes[i])
+            release(lods.keys[i]);
+        lods.meshes[i] = nullptr;
+    }
+}
+
+int MeshRegistry::getMeshCount()
+{
+    return s_meshes.size();
+}
+
+int MeshRegistry::getFreedCount()
+{
+    return s_freed;
+}
+
+bool MeshRegistry::isLive(unsigned int id)
+{
+    return s_ids.count(id) != 0;
+}
+
+size_t MeshRegistry::getBytesUsed()
+{
+    size_t bytes = 0;
+    for (auto& mesh : s_meshes)
+        bytes += mesh.second.mesh->getByteSize();
+    return bytes;
+}
+
+size_t MeshRegistry::getBytesSaved()
+{
+    size_t bytes = 0;
+    for (auto& mesh : s_meshes)
+        bytes += mesh.second.mesh->getByteSize() * (mesh.second.refs - 1);
+    return bytes;
+}
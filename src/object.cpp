@@ -3,104 +3,165 @@
 #include <iostream>
 #include <GL/glew.h>
 #include <glm/gtc/type_ptr.hpp>
-#include <glm/gtx/euler_angles.hpp>
 
 #include "app.hpp"
-
-Object::Object(const char* name) : m_name (name) {}
+#include "mesh.hpp"
+#include "shader.hpp"
+#include "rendercontext.hpp"
 
 Object::Object(Scene* scene, glm::vec3 pos, glm::vec3 size, const std::string& name)
     : m_scene       (scene),
-      m_position    (pos),
-      m_size        (size),
-      m_rotation    (1.0f),
-      m_name        (name)
-{}
+      m_texture     {0, GL_TEXTURE_2D},
+      m_drawTexture (0),
+      m_imageId     (-1),
+      m_textured    (false)
+{
+    m_slot = m_scene->getStore().add(this, name, pos, size);
+}
+
+Object::~Object()
+{
+    m_scene->getStore().remove(m_slot);
+    releaseTexture();
+    MeshRegistry::release(m_meshes);
+}
+
+size_t Object::getSlot()
+{
+    return m_slot;
+}
+
+void Object::setSlot(size_t slot)
+{
+    m_slot = slot;
+}
 
 glm::vec3 Object::getPosition()
 {
-    return m_position;
+    return m_scene->getStore().getTransforms().getPosition(m_slot);
 }
 
 void Object::setPosition(glm::vec3 pos) 
 {
-    m_position = pos;
+    m_scene->getStore().getTransforms().setPosition(m_slot, pos);
 }
 
 glm::vec3 Object::getSize()
 {
-    return m_size;
+    return m_scene->getStore().getTransforms().getSize(m_slot);
 }
 
 void Object::setSize(glm::vec3 size) 
 {
-    m_size = size;
+    m_scene->getStore().getTransforms().setSize(m_slot, size);
 }
 
 void Object::setRotation(float x, float y, float z)
 {
-    m_rotation = glm::eulerAngleXYZ(glm::radians(x), glm::radians(y), glm::radians(z));
+    m_scene->getStore().getTransforms().setRotation(m_slot, x, y, z);
 }
 
-void Object::update(const ImageFrameData& imgData)
+bool Object::update(const ImageFrameData& imgData, Object* imageSource)
 {
-    m_vao.bind();
-
-    const GLint modelLoc = glGetUniformLocation(m_scene->getShader(), "uModel");
-    m_model = glm::translate(glm::mat4(1.0f), m_position)
-        * m_rotation
-        * glm::scale(glm::mat4(1.0f), m_size);
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, &m_model[0][0]);
-
-    // bind and set texture
-    const GLint isTexLoc = glGetUniformLocation(m_scene->getShader(), "uIsTextured");
-
-    const glm::vec2 size(imgData.width, imgData.height);
-
-    if (!size.x)
+    m_textured = imgData.width != 0;
+    if (!m_textured)
     {
-        glUniform1i(isTexLoc, 0);
-        return;
+        releaseTexture();
+        return false;
     }
 
-    glUniform1i(isTexLoc, 1);
-    glBindTexture(m_texture.target, m_texture.id);
+    if (imageSource)
+    {
+        releaseTexture();
+        m_drawTexture = imageSource->getTexture();
+        return false;
+    }
 
-    if (size == m_lastTexSize)
-        return;
+    TextureKey key;
+    key.width = imgData.width;
+    key.height = imgData.height;
+    key.format = imgData.format;
 
-    const GLint internalFormat  = utils::glInternalFormat(imgData.format);
-    const GLenum format         = utils::glFormat(imgData.format);
-    const GLenum type           = utils::glType(imgData.format);
+    // swap for a pooled texture of the new size, the old one goes back for someone else
+    if (!m_texture.id || key != m_textureKey)
+    {
+        releaseTexture();
+        m_texture.id = TexturePool::acquire(key);
+        m_textureKey = key;
+    }
+    m_drawTexture = m_texture.id;
 
-    glGenTextures(1, &m_texture.id);
-    glBindTexture(GL_TEXTURE_2D, m_texture.id);
-    m_texture.target = GL_TEXTURE_2D;
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, imgData.width, imgData.height, 0, format, type, nullptr);
+    // a live video param gets a new image id every frame, a still image keeps its id
+    if (imgData.imageId == m_imageId)
+        return false;
 
     SenderFrame data;
     data.type = RS_FRAMETYPE_OPENGL_TEXTURE;
     data.gl.texture = m_texture.id;
     if (utils::rsGetFrameImage(imgData.imageId, &data))
+    {
         utils::logToD3(MSG(failed to get texture param info));
-    const GLint texLoc = glGetUniformLocation(m_scene->getShader(), "uTexture");
-    glUniform1i(texLoc, 0);
+        return false;
+    }
 
-    m_lastTexSize = size;
+    m_imageId = imgData.imageId;
+    return true;
+}
+
+void Object::releaseTexture()
+{
+    if (!m_texture.id)
+        return;
+
+    TexturePool::release(m_textureKey, m_texture.id);
+    m_texture.id = 0;
+    m_drawTexture = 0;
+    m_imageId = -1;
+}
+
+const glm::mat4& Object::getModel()
+{
+    return m_scene->getStore().getTransforms().getModel(m_slot);
+}
+
+void Object::setMeshes(const MeshLods& lods, MeshBuilder build)
+{
+    // acquire before releasing, so meshes both sets share aren't rebuilt
+    MeshLods old = m_meshes;
+    m_meshes = lods;
+    MeshRegistry::acquire(m_meshes, build);
+    MeshRegistry::release(old);
+    m_scene->getStore().setMeshes(m_slot, m_meshes);
+}
+
+VertexArray* Object::getVertexArray()
+{
+    return m_meshes.meshes[0];
+}
+
+const MeshKey& Object::getMeshKey()
+{
+    return m_meshes.keys[0];
+}
+
+const MeshLods& Object::getMeshes()
+{
+    return m_meshes;
+}
+
+bool Object::isTextured()
+{
+    return m_textured;
 }
 
-void Object::draw()
+GLuint Object::getTexture()
 {
-    glDrawElements(GL_TRIANGLES, m_vao.getIndexCount(), GL_UNSIGNED_INT, nullptr);
+    return m_drawTexture;
 }
 
-void Object::rotate(float deg, glm::vec3 dir) 
+void Object::draw(RenderContext& ctx)
 {
-    m_rotation = glm::rotate(m_rotation, glm::radians(deg), dir);
+    ctx.drawMesh(m_meshes.meshes[0], getModel(), m_textured ? m_drawTexture : 0);
 }
 
 ObjectType Object::getType()
@@ -110,5 +171,5 @@ ObjectType Object::getType()
 
 const char* Object::getName()
 {
-    return m_name.c_str();
+    return m_scene->getStore().getName(m_slot);
 }
\ No newline at end of file
@@ -0,0 +1,271 @@
+#include "profiler.hpp"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <fstream>
+
+static const char* s_stageNames[] = {
+    "await", "params", "images", "update", "render", "send", "ui", "total"
+};
+
+GpuTimer::GpuTimer(size_t capacity) : m_queries(capacity), m_next(0)
+{
+    for (Query& query : m_queries)
+    {
+        glGenQueries(1, &query.begin);
+        glGenQueries(1, &query.end);
+        query.pending = false;
+    }
+}
+
+GpuTimer::~GpuTimer()
+{
+    for (Query& query : m_queries)
+    {
+        glDeleteQueries(1, &query.begin);
+        glDeleteQueries(1, &query.end);
+    }
+}
+
+void GpuTimer::begin(uint64_t frame, StreamHandle handle, StreamStat stat)
+{
+    // if this is still pending nobody collected it in time, the old result is lost
+    Query& query = m_queries[m_next];
+    query.frame = frame;
+    query.handle = handle;
+    query.stat = stat;
+    query.pending = true;
+    glQueryCounter(query.begin, GL_TIMESTAMP);
+}
+
+void GpuTimer::end()
+{
+    glQueryCounter(m_queries[m_next].end, GL_TIMESTAMP);
+    m_next = (m_next + 1) % m_queries.size();
+}
+
+void GpuTimer::collect(std::vector<GpuTiming>& out)
+{
+    for (Query& query : m_queries)
+    {
+        if (!query.pending)
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        GLuint64 begin, end;
+        glGetQueryObjectui64v(query.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &end);
+        query.pending = false;
+
+        GpuTiming timing;
+        timing.frame = query.frame;
+        timing.handle = query.handle;
+        timing.stat = query.stat;
+        timing.ms = (end - begin) / 1000000.f;
+        out.push_back(timing);
+    }
+}
+
+Profiler::Profiler(size_t capacity)
+    : m_frames      (capacity),
+      m_head        (0),
+      m_count       (0),
+      m_index       (0),
+      m_frameStart  (0)
+{
+    m_scratch.reserve(capacity);
+}
+
+FrameTiming& Profiler::current()
+{
+    return m_frames[m_head];
+}
+
+FrameTiming* Profiler::find(uint64_t frame)
+{
+    // search backwards from the iteration in progress
+    for (size_t i = 0; i <= m_count; ++i)
+    {
+        FrameTiming& timing = m_frames[(m_head + m_frames.size() - i) % m_frames.size()];
+        if (timing.frame == (int64_t)frame)
+            return &timing;
+    }
+    return nullptr;
+}
+
+void Profiler::beginFrame()
+{
+    // the oldest record gets reused once the ring is full
+    if (m_count == m_frames.size())
+        --m_count;
+
+    FrameTiming& timing = current();
+    timing.index = m_index++;
+    timing.frame = -1;
+    std::fill(timing.stages, timing.stages + Stage_Count, 0.f);
+    timing.total = 0;
+    timing.streamCount = 0;
+
+    m_frameStart = glfwGetTime();
+}
+
+void Profiler::endFrame()
+{
+    current().total = (glfwGetTime() - m_frameStart) * 1000.0;
+    m_head = (m_head + 1) % m_frames.size();
+    ++m_count;
+}
+
+void Profiler::setFrame(uint64_t frame)
+{
+    current().frame = frame;
+}
+
+void Profiler::addStage(ProfileStage stage, float ms)
+{
+    current().stages[stage] += ms;
+}
+
+void Profiler::addStreamTime(uint64_t frame, StreamHandle handle, StreamStat stat, float ms)
+{
+    FrameTiming* timing = find(frame);
+    if (!timing)
+        return;
+
+    for (int i = 0; i < timing->streamCount; ++i)
+    {
+        StreamTiming& stream = timing->streams[i];
+        if (stream.handle == handle)
+        {
+            stream.ms[stat] += ms;
+            return;
+        }
+    }
+
+    if (timing->streamCount == PROFILER_MAX_STREAMS)
+        return;
+
+    StreamTiming& stream = timing->streams[timing->streamCount++];
+    stream = StreamTiming();
+    stream.handle = handle;
+    stream.ms[stat] = ms;
+}
+
+size_t Profiler::getCount()
+{
+    return m_count;
+}
+
+const FrameTiming& Profiler::getFrame(size_t i)
+{
+    return m_frames[(m_head + m_frames.size() - m_count + i) % m_frames.size()];
+}
+
+TimingStats Profiler::scratchStats()
+{
+    TimingStats stats;
+    if (m_scratch.empty())
+        return stats;
+
+    float sum = 0;
+    stats.min = m_scratch[0];
+    for (float ms : m_scratch)
+    {
+        stats.min = std::min(stats.min, ms);
+        sum += ms;
+    }
+    stats.avg = sum / m_scratch.size();
+
+    const size_t p99 = (m_scratch.size() - 1) * 99 / 100;
+    std::nth_element(m_scratch.begin(), m_scratch.begin() + p99, m_scratch.end());
+    stats.p99 = m_scratch[p99];
+
+    return stats;
+}
+
+TimingStats Profiler::getStats(int stage)
+{
+    m_scratch.clear();
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        const FrameTiming& timing = getFrame(i);
+        m_scratch.push_back(stage == Stage_Count ? timing.total : timing.stages[stage]);
+    }
+    return scratchStats();
+}
+
+TimingStats Profiler::getStreamStats(StreamHandle handle, StreamStat stat)
+{
+    m_scratch.clear();
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        // zero means not recorded yet, e.g. the newest frames haven't been sent
+        const FrameTiming& timing = getFrame(i);
+        for (int j = 0; j < timing.streamCount; ++j)
+        {
+            const StreamTiming& stream = timing.streams[j];
+            if (stream.handle == handle && stream.ms[stat] > 0)
+                m_scratch.push_back(stream.ms[stat]);
+        }
+    }
+    return scratchStats();
+}
+
+bool Profiler::writeCsv(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    file << "iteration,frame";
+    for (int i = 0; i <= Stage_Count; ++i)
+        file << "," << s_stageNames[i] << "_ms";
+    file << ",stream,stream_render_ms,stream_gpu_ms,stream_resolve_ms,stream_upscale_ms,stream_send_ms\n";
+
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        const FrameTiming& timing = getFrame(i);
+
+        // iterations that didn't render still get a row, with empty stream columns
+        const int rows = std::max(timing.streamCount, 1);
+        for (int j = 0; j < rows; ++j)
+        {
+            file << timing.index << "," << timing.frame;
+            for (int k = 0; k < Stage_Count; ++k)
+                file << "," << timing.stages[k];
+            file << "," << timing.total;
+
+            if (j < timing.streamCount)
+            {
+                const StreamTiming& stream = timing.streams[j];
+                file << "," << stream.handle;
+                for (int k = 0; k < Stream_StatCount; ++k)
+                    file << "," << stream.ms[k];
+            }
+            else file << ",,,,,,";
+            file << "\n";
+        }
+    }
+
+    return file.good();
+}
+
+const char* Profiler::getStageName(int stage)
+{
+    return s_stageNames[stage];
+}
+
+ProfileScope::ProfileScope(Profiler& profiler, ProfileStage stage)
+    : profiler  (profiler),
+      stage     (stage),
+      start     (glfwGetTime())
+{}
+
+ProfileScope::~ProfileScope()
+{
+    profiler.addStage(stage, (glfwGetTime() - start) * 1000.0);
+}
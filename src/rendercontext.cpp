@@ -0,0 +1,306 @@
+#include "rendercontext.hpp"
+
+#include "object.hpp"
+#include "mesh.hpp"
+#include "shader.hpp"
+
+InstanceBatch::InstanceBatch() : m_capacity(0), m_mesh(nullptr), m_count(0), m_changed(false)
+{
+    glGenBuffers(1, &m_vbo);
+}
+
+InstanceBatch::~InstanceBatch()
+{
+    glDeleteBuffers(1, &m_vbo);
+}
+
+void InstanceBatch::clear()
+{
+    // keep last frame's models around, batches are refilled every frame
+    m_count = 0;
+    m_mesh = nullptr;
+}
+
+void InstanceBatch::add(VertexArray* mesh, const glm::mat4& model)
+{
+    if (!m_mesh)
+        m_mesh = mesh;
+
+    if (m_count == m_models.size())
+    {
+        m_models.push_back(model);
+        m_changed = true;
+    }
+    else if (m_models[m_count] != model)
+    {
+        m_models[m_count] = model;
+        m_changed = true;
+    }
+    ++m_count;
+}
+
+void InstanceBatch::draw(RenderContext& ctx)
+{
+    if (!m_count)
+        return;
+
+    ctx.bindMesh(m_mesh);
+
+    // the buffer always holds every model in m_models, so only a change
+    // or a bigger buffer needs an upload
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    if (m_models.size() > m_capacity)
+    {
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * m_models.size(), nullptr, GL_STREAM_DRAW);
+        m_capacity = m_models.size();
+        m_changed = true;
+    }
+    if (m_changed)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::mat4) * m_models.size(), m_models.data());
+        m_changed = false;
+    }
+
+    // a mat4 attrib takes up four consecutive vec4 locations
+    for (int i = 0; i < 4; ++i)
+    {
+        const GLuint loc = 3 + i;
+        glEnableVertexAttribArray(loc);
+        glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (const void*)(sizeof(glm::vec4) * i));
+        glVertexAttribDivisor(loc, 1);
+    }
+
+    glDrawElementsInstanced(GL_TRIANGLES, m_mesh->getIndexCount(), GL_UNSIGNED_INT, nullptr, m_count);
+}
+
+size_t InstanceBatch::getCount()
+{
+    return m_count;
+}
+
+RenderContext::RenderContext(GLFWwindow* window)
+    : m_window          (window),
+      m_frameUniforms   (new UniformBuffer()),
+      m_meshesFreed     (0),
+      m_timer           (new GpuTimer())
+{
+    m_shader = Scene::createShader(m_uniforms);
+
+    m_frameUniforms->addBlock(Block_Camera, sizeof(CameraBlock));
+    m_frameUniforms->addBlock(Block_Lighting, sizeof(LightingBlock));
+    m_frameUniforms->build();
+
+    // enable gl depth testing and set to draw when the incoming depth value is less than the stored depth value
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+}
+
+RenderContext::~RenderContext()
+{
+    for (auto& batch : m_batches)
+        delete batch.second;
+    for (auto& vao : m_vaos)
+        glDeleteVertexArrays(1, &vao.second);
+    clearFramebuffers();
+    delete m_frameUniforms;
+    delete m_timer;
+    delete m_shader;
+}
+
+GLFWwindow* RenderContext::getWindow()
+{
+    return m_window;
+}
+
+ShaderProgram* RenderContext::getShader()
+{
+    return m_shader;
+}
+
+const SceneUniforms& RenderContext::getUniforms()
+{
+    return m_uniforms;
+}
+
+UniformBuffer& RenderContext::getFrameUniforms()
+{
+    return *m_frameUniforms;
+}
+
+void RenderContext::sweepMeshes()
+{
+    if (m_meshesFreed == MeshRegistry::getFreedCount())
+        return;
+    m_meshesFreed = MeshRegistry::getFreedCount();
+
+    for (auto it = m_vaos.begin(); it != m_vaos.end();)
+    {
+        if (MeshRegistry::isLive(it->first))
+        {
+            ++it;
+            continue;
+        }
+        glDeleteVertexArrays(1, &it->second);
+        it = m_vaos.erase(it);
+    }
+}
+
+void RenderContext::bindMesh(VertexArray* mesh)
+{
+    GLuint& vao = m_vaos[mesh->getId()];
+    if (vao)
+    {
+        glBindVertexArray(vao);
+        return;
+    }
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    mesh->setupAttribs();
+}
+
+GLuint RenderContext::getFramebuffer(const RenderTarget& target)
+{
+    GLuint& frameBuf = m_framebuffers[target.texture];
+    if (frameBuf)
+        return frameBuf;
+
+    glGenFramebuffers(1, &frameBuf);
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuf);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthBuf);
+    if (target.colourBuf)
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colourBuf);
+    else
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.texture, 0);
+
+    GLenum bufs[] = { GL_COLOR_ATTACHMENT0 };
+    glDrawBuffers(1, bufs);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return frameBuf;
+}
+
+GLuint RenderContext::getResolveFramebuffer(const RenderTarget& target)
+{
+    if (!target.colourBuf)
+        return 0;
+
+    GLuint& resolveBuf = m_resolveBuffers[target.texture];
+    if (resolveBuf)
+        return resolveBuf;
+
+    glGenFramebuffers(1, &resolveBuf);
+    glBindFramebuffer(GL_FRAMEBUFFER, resolveBuf);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.texture, 0);
+
+    GLenum bufs[] = { GL_COLOR_ATTACHMENT0 };
+    glDrawBuffers(1, bufs);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return resolveBuf;
+}
+
+void RenderContext::clearFramebuffers()
+{
+    for (auto& frameBuf : m_framebuffers)
+        glDeleteFramebuffers(1, &frameBuf.second);
+    for (auto& resolveBuf : m_resolveBuffers)
+        glDeleteFramebuffers(1, &resolveBuf.second);
+    m_framebuffers.clear();
+    m_resolveBuffers.clear();
+}
+
+void RenderContext::clearBatches()
+{
+    for (auto& batch : m_batches)
+        batch.second->clear();
+}
+
+void RenderContext::addInstance(const MeshKey& key, VertexArray* mesh, const glm::mat4& model)
+{
+    InstanceBatch*& batch = m_batches[key];
+    if (!batch)
+        batch = new InstanceBatch();
+    batch->add(mesh, model);
+}
+
+void RenderContext::drawBatches()
+{
+    if (m_batches.empty())
+        return;
+
+    m_shader->setInt(m_uniforms.instanced, 1);
+    m_shader->setInt(m_uniforms.isTextured, 0);
+
+    for (auto& batch : m_batches)
+        batch.second->draw(*this);
+
+    m_shader->setInt(m_uniforms.instanced, 0);
+}
+
+void RenderContext::drawMesh(VertexArray* mesh, const glm::mat4& model, GLuint texture)
+{
+    bindMesh(mesh);
+    m_shader->setMat4(m_uniforms.model, model);
+    m_shader->setInt(m_uniforms.isTextured, texture != 0);
+
+    if (texture)
+    {
+        m_shader->setInt(m_uniforms.texture, 0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+
+    glDrawElements(GL_TRIANGLES, mesh->getIndexCount(), GL_UNSIGNED_INT, nullptr);
+}
+
+void RenderContext::render(StreamJob& job)
+{
+    const double start = glfwGetTime();
+    sweepMeshes();
+    m_timer->begin(job.frame, job.handle);
+
+    // while scaling, the stream is drawn into the corner of its scaled target, resolved
+    // there if it's multisampled, and then stretched over the texture that gets sent
+    const RenderTarget& target = *job.target;
+    const RenderTarget& drawn = job.scaled ? *job.scaled : target;
+    const GLuint frameBuf = getFramebuffer(drawn);
+    const GLuint resolveBuf = getResolveFramebuffer(drawn);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, frameBuf);
+    glViewport(0, 0, job.renderWidth, job.renderHeight);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    job.scene->render(*this, job);
+
+    m_timer->end();
+
+    if (resolveBuf)
+    {
+        m_timer->begin(job.frame, job.handle, Stream_Resolve);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuf);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveBuf);
+        glBlitFramebuffer(0, 0, job.renderWidth, job.renderHeight, 0, 0, job.renderWidth, job.renderHeight,
+            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        m_timer->end();
+    }
+
+    if (job.scaled)
+    {
+        // the target only has its texture while scaling, so this writes it directly
+        const GLuint outputBuf = getFramebuffer(target);
+        m_timer->begin(job.frame, job.handle, Stream_Upscale);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, resolveBuf ? resolveBuf : frameBuf);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputBuf);
+        glBlitFramebuffer(0, 0, job.renderWidth, job.renderHeight, 0, 0, job.width, job.height,
+            GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        m_timer->end();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    job.renderTime = (glfwGetTime() - start) * 1000.0;
+}
+
+void RenderContext::collectGpuTimes(std::vector<GpuTiming>& out)
+{
+    m_timer->collect(out);
+}
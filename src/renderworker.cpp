@@ -0,0 +1,120 @@
+#include "renderworker.hpp"
+
+RenderWorker::RenderWorker(GLFWwindow* share)
+    : m_updateFence     (nullptr),
+      m_busy            (false),
+      m_targetsChanged  (false),
+      m_quit            (false)
+{
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    m_window = glfwCreateWindow(1, 1, "RsTest worker", NULL, share);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (!m_window)
+    {
+        utils::error("failed to create render worker context :(");
+        return;
+    }
+
+    m_thread = std::thread(&RenderWorker::run, this);
+}
+
+RenderWorker::~RenderWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_cv.notify_all();
+
+    if (!m_thread.joinable())
+        return;
+
+    m_thread.join();
+    glfwDestroyWindow(m_window);
+}
+
+bool RenderWorker::isRunning() const
+{
+    return m_window != nullptr;
+}
+
+void RenderWorker::clearJobs()
+{
+    m_jobs.clear();
+}
+
+void RenderWorker::addJob(StreamJob* job)
+{
+    m_jobs.push_back(job);
+}
+
+void RenderWorker::start(GLsync updateFence)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_updateFence = updateFence;
+        m_busy = true;
+    }
+    m_cv.notify_all();
+}
+
+void RenderWorker::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return !m_busy; });
+}
+
+void RenderWorker::invalidateTargets()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_targetsChanged = true;
+}
+
+const std::vector<GpuTiming>& RenderWorker::getGpuTimes()
+{
+    return m_gpuTimes;
+}
+
+void RenderWorker::run()
+{
+    glfwMakeContextCurrent(m_window);
+    RenderContext* ctx = new RenderContext(m_window);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_cv.wait(lock, [this] { return m_busy || m_quit; });
+        if (m_quit)
+            break;
+
+        if (m_targetsChanged)
+        {
+            ctx->clearFramebuffers();
+            m_targetsChanged = false;
+        }
+        lock.unlock();
+
+        // textures and instance data written by the main thread this frame
+        glWaitSync(m_updateFence, 0, GL_TIMEOUT_IGNORED);
+
+        for (StreamJob* job : m_jobs)
+        {
+            ctx->render(*job);
+            job->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        // make sure the fences reach the gpu before the main thread waits on them
+        glFlush();
+
+        m_gpuTimes.clear();
+        ctx->collectGpuTimes(m_gpuTimes);
+
+        lock.lock();
+        m_busy = false;
+        m_cv.notify_all();
+    }
+    lock.unlock();
+
+    delete ctx;
+    glfwMakeContextCurrent(nullptr);
+}
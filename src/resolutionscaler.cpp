@@ -0,0 +1,56 @@
+#include "resolutionscaler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// the scale moves in steps of this, so small changes in frame time don't change it
+static const float SCALE_STEP = .05f;
+// frames are aimed at this much of the budget, leaving room for spikes
+static const float BUDGET_USE = .9f;
+// frames have to take less than this much of the budget for the scale to go up
+static const float HEADROOM = .7f;
+// frames in a row with headroom before going up a step
+static const int HEADROOM_FRAMES = 30;
+
+ResolutionScaler::ResolutionScaler() : m_scale (1.f), m_headroomFrames (0) {}
+
+bool ResolutionScaler::update(float frameMs, float targetFps, float minScale)
+{
+    if (frameMs <= 0 || targetFps <= 0)
+        return false;
+
+    const float budget = 1000.f / targetFps;
+    const float before = m_scale;
+
+    if (frameMs > budget * BUDGET_USE)
+    {
+        // render cost goes with pixel count, so the square root of how far over
+        // budget the frame was is what each side has to shrink by
+        const float wanted = m_scale * std::sqrt(budget * BUDGET_USE / frameMs);
+        m_scale = std::floor(wanted / SCALE_STEP + .001f) * SCALE_STEP;
+        m_headroomFrames = 0;
+    }
+    else if (frameMs < budget * HEADROOM)
+    {
+        if (++m_headroomFrames >= HEADROOM_FRAMES)
+        {
+            m_scale = std::round(m_scale / SCALE_STEP + 1) * SCALE_STEP;
+            m_headroomFrames = 0;
+        }
+    }
+    else m_headroomFrames = 0;
+
+    m_scale = std::min(std::max(m_scale, minScale), 1.f);
+    return m_scale != before;
+}
+
+void ResolutionScaler::reset()
+{
+    m_scale = 1.f;
+    m_headroomFrames = 0;
+}
+
+float ResolutionScaler::getScale()
+{
+    return m_scale;
+}
@@ -5,33 +5,83 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 
 #include "object.hpp"
 #include "shape.hpp"
 #include "utils.hpp"
 #include "app.hpp"
+#include "shader.hpp"
+#include "rendercontext.hpp"
 
-Scene::Scene(std::string name) : m_currentCamera(new Camera(this, glm::vec3(-10, 0, -1))),
-                                 m_rsScene      (new RsScene()),
+Scene::Scene(std::string name) : m_name         (name),
+                                 m_currentCamera(new Camera(this, glm::vec3(-10, 0, -1))),
+                                 m_offsetsDirty (false),
                                  m_light        (glm::vec3(20.f, -15.f, 0.f), 1.f, .4f, v4(1.f)),
-                                 m_name         (name)
+                                 m_rsScene      (new RsScene()),
+                                 m_lighting     (),
+                                 m_transformsUpdated (0),
+                                 m_imageFetches (0),
+                                 m_imageFetchesSaved (0)
+{
+    m_rsScene->name = m_name.c_str();
+
+    const std::string nameStr(name);
+
+    // ambient light params
+    m_rsScene->addParam(RsFloatParam(nameStr + "amb_strength", "ambient strength", "scene", .4, 0, 1, 0.05)); // 0
+    m_rsScene->addParam(RsFloatParam(nameStr + "ambcol_r", "ambient colour_r", "scene", 1, 0, 1, .01)); // 1
+    m_rsScene->addParam(RsFloatParam(nameStr + "ambcol_g", "ambient colour_g", "scene", 1, 0, 1, .01)); // 2
+    m_rsScene->addParam(RsFloatParam(nameStr + "ambcol_b", "ambient colour_b", "scene", 1, 0, 1, .01)); // 3
+    m_rsScene->addParam(RsFloatParam(nameStr + "ambcol_a", "ambientcolour_a", "scene", 1, 0, 1, .01)); // 4
+
+    // parameters for scene light
+    m_rsScene->addParam(RsFloatParam(nameStr + "lightpos_x", "pos_x", "light", 0, -100, 100, 0.1)); // 5
+    m_rsScene->addParam(RsFloatParam(nameStr + "lightpos_y", "pos_y", "light", 5, -100, 100, 0.1)); // 6
+    m_rsScene->addParam(RsFloatParam(nameStr + "lightpos_z", "pos_z", "light", 0, -100, 100, 0.1)); // 7
+    m_rsScene->addParam(RsFloatParam(nameStr + "lightcol_r", "light colour_r", "light", 1, 0, 1, .01)); // 8
+    m_rsScene->addParam(RsFloatParam(nameStr + "lightcol_g", "light colour_g", "light", 1, 0, 1, .01)); // 9
+    m_rsScene->addParam(RsFloatParam(nameStr + "lightcol_b", "light colour_b", "light", 1, 0, 1, .01)); // 10
+    m_rsScene->addParam(RsFloatParam(nameStr + "lightcol_a", "light colour_a", "light", 1, 0, 1, .01)); // 11
+    m_rsScene->addParam(RsFloatParam(nameStr + "brightness", "brightness", "light", 1, 0, 2, 0.1)); // 12
+
+    App::getSchema().addScene(*m_rsScene);
+    App::reloadSchema();
+
+    updateMatrices();
+}
+
+Scene::~Scene(){
+    // from the back, so nothing has to be moved into the freed slots
+    while (m_store.getCount())
+        delete m_store.getObject(m_store.getCount() - 1);
+    delete m_rsScene;
+}
+
+ShaderProgram* Scene::createShader(SceneUniforms& uniforms)
 {
     const GLchar* vsSource[] = {R"src(#version 330 core
     layout (location = 0) in vec4 aPosition;
     layout (location = 1) in vec2 aTexCoord;
     layout (location = 2) in vec4 aNormal;
+    layout (location = 3) in mat4 aInstanceModel;
 
     out vec4 fragPos;
     out vec4 normal;
     out vec2 texCoord;
 
+    layout (std140) uniform CameraBlock {
+        mat4 uView;
+        mat4 uProj;
+    };
+
     uniform mat4 uModel;
-    uniform mat4 uView;
-    uniform mat4 uProj;
+    uniform bool uInstanced;
 
     void main() {
-        fragPos = uModel * aPosition;
-        normal = uModel * aNormal;
+        mat4 model = uInstanced ? aInstanceModel : uModel;
+        fragPos = model * aPosition;
+        normal = model * aNormal;
         texCoord = vec2(1, 1) - aTexCoord;
         gl_Position = uProj * uView * fragPos;
     }
@@ -42,11 +92,14 @@ Scene::Scene(std::string name) : m_currentCamera(new Camera(this, glm::vec3(-10,
     in vec4 normal;
     in vec2 texCoord;
 
-    uniform vec3 uLightPos;
-    uniform vec4 uLightColour;
-    uniform float uLightBrightness;
-    uniform vec4 uAmbientColour;
-    uniform float uAmbientStrength;
+    layout (std140) uniform LightingBlock {
+        vec4 uLightPos;
+        vec4 uLightColour;
+        vec4 uAmbientColour;
+        float uLightBrightness;
+        float uAmbientStrength;
+    };
+
     uniform bool uIsTextured;
     uniform sampler2D uTexture;
 
@@ -58,7 +111,7 @@ Scene::Scene(std::string name) : m_currentCamera(new Camera(this, glm::vec3(-10,
             texColour = texture(uTexture, texCoord);
         else
             texColour = vec4(1, 1, 1, 1);
-        vec4 lightDir = normalize(vec4(uLightPos, 1.f) - fragPos);
+        vec4 lightDir = normalize(vec4(uLightPos.xyz, 1.f) - fragPos);
         float diffuseStrength = max(dot(norm, lightDir), 0.0f) * uLightBrightness;	
         vec4 diffuse = diffuseStrength * uLightColour;
         vec4 result = ambient + diffuse;
@@ -66,40 +119,21 @@ Scene::Scene(std::string name) : m_currentCamera(new Camera(this, glm::vec3(-10,
     }
     )src" };
 
-    m_shader = utils::createShader(vsSource, fsSource);
+    ShaderProgram* shader = new ShaderProgram(vsSource, fsSource);
 
-    glUseProgram(m_shader);
+    shader->use();
     utils::checkGLError(" creating shader program");
 
-    m_rsScene->name = m_name.c_str();
+    uniforms.model            = shader->getUniform("uModel");
+    uniforms.instanced        = shader->getUniform("uInstanced");
+    uniforms.isTextured       = shader->getUniform("uIsTextured");
+    uniforms.texture          = shader->getUniform("uTexture");
 
-    const std::string nameStr(name);
+    // camera and lighting come from the render context's uniform buffer
+    shader->bindBlock("CameraBlock", Block_Camera);
+    shader->bindBlock("LightingBlock", Block_Lighting);
 
-    // ambient light params
-    m_rsScene->addParam(RsFloatParam(nameStr + "amb_strength", "ambient strength", "scene", .4, 0, 1, 0.05)); // 0
-    m_rsScene->addParam(RsFloatParam(nameStr + "ambcol_r", "ambient colour_r", "scene", 1, 0, 1, .01)); // 1
-    m_rsScene->addParam(RsFloatParam(nameStr + "ambcol_g", "ambient colour_g", "scene", 1, 0, 1, .01)); // 2
-    m_rsScene->addParam(RsFloatParam(nameStr + "ambcol_b", "ambient colour_b", "scene", 1, 0, 1, .01)); // 3
-    m_rsScene->addParam(RsFloatParam(nameStr + "ambcol_a", "ambientcolour_a", "scene", 1, 0, 1, .01)); // 4
-
-    // parameters for scene light
-    m_rsScene->addParam(RsFloatParam(nameStr + "lightpos_x", "pos_x", "light", 0, -100, 100, 0.1)); // 5
-    m_rsScene->addParam(RsFloatParam(nameStr + "lightpos_y", "pos_y", "light", 5, -100, 100, 0.1)); // 6
-    m_rsScene->addParam(RsFloatParam(nameStr + "lightpos_z", "pos_z", "light", 0, -100, 100, 0.1)); // 7
-    m_rsScene->addParam(RsFloatParam(nameStr + "lightcol_r", "light colour_r", "light", 1, 0, 1, .01)); // 8
-    m_rsScene->addParam(RsFloatParam(nameStr + "lightcol_g", "light colour_g", "light", 1, 0, 1, .01)); // 9
-    m_rsScene->addParam(RsFloatParam(nameStr + "lightcol_b", "light colour_b", "light", 1, 0, 1, .01)); // 10
-    m_rsScene->addParam(RsFloatParam(nameStr + "lightcol_a", "light colour_a", "light", 1, 0, 1, .01)); // 11
-    m_rsScene->addParam(RsFloatParam(nameStr + "brightness", "brightness", "light", 1, 0, 2, 0.1)); // 12
-
-    App::getSchema().addScene(*m_rsScene);
-    App::reloadSchema();
-
-    updateMatrices();
-}
-
-Scene::~Scene(){
-    glDeleteShader(m_shader);
+    return shader;
 }
 
 void Scene::updateMatrices() {
@@ -109,16 +143,18 @@ void Scene::updateMatrices() {
     const glm::vec3 camPos(m_currentCamera->getPosition());
     const glm::vec3 camFront(m_currentCamera->getFront());
     const glm::vec3 camUp(m_currentCamera->getUp());
-    const glm::mat4 m_projection = glm::perspective(glm::radians(m_currentCamera->getFov()), width / height, 0.1f, 9000.0f);
-    const glm::mat4 m_view = glm::lookAt(camPos, camPos + camFront, camUp);
+    m_projection = glm::perspective(glm::radians(m_currentCamera->getFov()), width / height, 0.1f, 9000.0f);
+    m_view = glm::lookAt(camPos, camPos + camFront, camUp);
+}
 
-    const unsigned int viewLoc = glGetUniformLocation(m_shader, "uView");
-    const unsigned int projLoc = glGetUniformLocation(m_shader, "uProj");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, &m_view[0][0]);
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, &m_projection[0][0]);
+CameraBlock Scene::getCameraBlock() {
+    CameraBlock block;
+    block.view = m_view;
+    block.proj = m_projection;
+    return block;
 }
 
-void Scene::render(){
+void Scene::update(){
 
     const std::vector<float>& params = App::getParams();
 
@@ -132,37 +168,176 @@ void Scene::render(){
     m_light.setColour(v4(params[8], params[9], params[10], params[11]));
     m_light.setBrightness(params[12]);
 
-    const unsigned int ambientStrenLoc = glGetUniformLocation(m_shader, "uAmbientStrength");
-    const unsigned int ambientColLoc = glGetUniformLocation(m_shader, "uAmbientColour");
-    const unsigned int lightPosLoc = glGetUniformLocation(m_shader, "uLightPos");
-    const unsigned int lightColourLoc = glGetUniformLocation(m_shader, "uLightColour");
-    const unsigned int brightnessLoc = glGetUniformLocation(m_shader, "uLightBrightness");
+    m_lighting.lightPos = v4(m_light.getPosition(), 1.f);
+    m_lighting.lightColour = m_light.getColour();
+    m_lighting.ambientColour = m_ambColour;
+    m_lighting.lightBrightness = m_light.getBrightness();
+    m_lighting.ambientStrength = m_ambStrength;
+
+    const std::vector<ImageFrameData>& imgData = App::getImgData();
+
+    m_imageSources.clear();
+    m_transformsUpdated = 0;
+    m_imageFetches = 0;
+    m_imageFetchesSaved = 0;
+
+    if (m_offsetsDirty)
+    {
+        m_store.setParamOffsets(m_rsScene->getLayout());
+        m_offsetsDirty = false;
+    }
+
+    static const ImageFrameData noImage = ImageFrameData();
+    const size_t count = m_store.getCount();
+    TransformStore& transforms = m_store.getTransforms();
+
+    // copy every object's position, rotation and scale in and rebuild the
+    // model matrices of the ones that changed, several at a time
+    for (size_t slot = 0; slot < count; ++slot)
+    {
+        const uint32_t offset = m_store.getNumberOffset(slot);
+        if (offset != ObjectStore::NO_PARAMS && transforms.set(slot, &params[offset]))
+            m_transformsUpdated++;
+    }
+    transforms.build();
+    m_store.updateBounds();
+
+    for (size_t slot = 0; slot < count; ++slot)
+    {
+        Object* obj = m_store.getObject(slot);
+
+        // objects mapped to the same media get the same image id, only the
+        // first one fetches it and the rest sample its texture
+        const uint32_t imageOffset = m_store.getImageOffset(slot);
+        const ImageFrameData& img = imageOffset != ObjectStore::NO_PARAMS ? imgData[imageOffset] : noImage;
+
+        Object* source = nullptr;
+        if (img.width)
+        {
+            for (const auto& image : m_imageSources)
+            {
+                if (image.first == img.imageId)
+                {
+                    source = image.second;
+                    break;
+                }
+            }
+        }
+
+        if (source)
+        {
+            obj->update(img, source);
+            m_imageFetchesSaved++;
+        }
+        else
+        {
+            if (obj->update(img))
+                m_imageFetches++;
+            if (img.width)
+                m_imageSources.push_back(std::make_pair(img.imageId, obj));
+        }
+
+        m_store.setTexture(slot, obj->isTextured() ? obj->getTexture() : 0);
+    }
+}
+
+// smallest projected radius in pixels each level of detail is drawn at
+static const float s_lodRadii[MESH_LODS] = { 48.f, 12.f, 0.f };
+
+void Scene::render(RenderContext& ctx, StreamJob& job){
+    const CameraBlock& camera = job.camera;
+    DrawStats& stats = job.stats;
 
-    glUniform1f(ambientStrenLoc, m_ambStrength);
-    glUniform4fv(ambientColLoc, 1, &m_ambColour[0]);
-    glUniform3fv(lightPosLoc, 1, &m_light.getPosition()[0]);
-    glUniform4fv(lightColourLoc, 1, &m_light.getColour()[0]);
-    glUniform1f(brightnessLoc, m_light.getBrightness());
+    UniformBuffer& frameUniforms = ctx.getFrameUniforms();
+    frameUniforms.write(Block_Camera, &camera, sizeof(camera));
+    frameUniforms.write(Block_Lighting, &m_lighting, sizeof(m_lighting));
+    frameUniforms.upload();
+
+    ctx.getShader()->use();
 
     if (!getObjectCount())
         return;
 
-    const std::vector<ImageFrameData>& imgData = App::getImgData();
+    const Config& config = App::getConfig();
+    const size_t count = m_store.getCount();
+    TransformStore& transforms = m_store.getTransforms();
+    const Frustum frustum(camera.proj * camera.view);
+
+    // world units at a depth of one to pixels, from the vertical field of view
+    const float pixelScale = camera.proj[1][1] * job.renderHeight * .5f;
+    ctx.clearBatches();
 
-    for (int i = 0; i < m_objects.size(); ++i)
+    for (size_t slot = 0; slot < count; ++slot)
     {
-        Object* obj = m_objects[i];
+        const glm::vec4& bounds = m_store.getBounds(slot);
+        if (config.culling && !frustum.intersects(bounds))
+        {
+            stats.culled++;
+            continue;
+        }
+        stats.drawn++;
+
+        const MeshLods& meshes = m_store.getMeshes(slot);
+        int level = 0;
+        if (config.lod && meshes.count > 1)
+        {
+            // a level is only left once the radius is past its threshold by the
+            // hysteresis margin, so objects near one don't flicker between levels
+            const float depth = -(camera.view * glm::vec4(glm::vec3(bounds), 1.f)).z;
+            const float radius = depth > bounds.w ? bounds.w / depth * pixelScale : 1e30f;
+            uint8_t& previous = m_store.getLod(slot, job.stream);
+            level = std::min((int)previous, meshes.count - 1);
+            while (level > 0 && radius >= s_lodRadii[level - 1] * (1.f + config.lodHysteresis))
+                level--;
+            while (level < meshes.count - 1 && radius < s_lodRadii[level] * (1.f - config.lodHysteresis))
+                level++;
+            previous = level;
+        }
+
+        VertexArray* mesh = meshes.meshes[level];
+        stats.triangles += mesh->getIndexCount() / 3;
+        stats.fullTriangles += meshes.meshes[0]->getIndexCount() / 3;
+
+        // untextured objects only differ by their model matrix, so they
+        // are grouped by mesh and drawn instanced after this loop
+        const unsigned int texture = m_store.getTexture(slot);
+        if (config.instancing && !texture)
+        {
+            ctx.addInstance(meshes.keys[level], mesh, transforms.getModel(slot));
+            continue;
+        }
+
+        ctx.drawMesh(mesh, transforms.getModel(slot), texture);
+    }
 
-        int ind = i * 9 + 13;
+    ctx.drawBatches();
+}
 
-        // set object position, rotation, scale to values returned by frame parameters
-        obj->setPosition(glm::vec3(params[ind + 2], -params[ind + 1], params[ind]));
-        obj->setRotation(-params[ind + 5], params[ind + 3], -params[ind + 4]);
-        obj->setSize(v3(params[ind + 6], params[ind + 7], params[ind + 8]));
-        obj->update(imgData[i]);
+Frustum::Frustum(const glm::mat4& viewProj)
+{
+    // each plane is the last row of the matrix plus or minus one of the others,
+    // glm matrices are indexed by column so rows are gathered by hand
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
 
-        obj->draw();
+    for (int i = 0; i < 3; ++i)
+    {
+        planes[i * 2] = rows[3] + rows[i];
+        planes[i * 2 + 1] = rows[3] - rows[i];
     }
+
+    // normalised so the distance to a plane can be compared with a radius
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::intersects(const glm::vec4& sphere) const
+{
+    for (const glm::vec4& plane : planes)
+        if (glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w < -sphere.w)
+            return false;
+    return true;
 }
 
 Object* Scene::addObject(ObjectType type, ObjectArgs args){
@@ -186,22 +361,22 @@ Object* Scene::addObject(ObjectType type, ObjectArgs args){
         break;
     }
 
-    m_objects.push_back(obj);
+    m_offsetsDirty = true;
 
     // use prefix to identify object by its scene and name
     const std::string prefix = m_name + args.name;
 
-    m_rsScene->addParam(RsFloatParam(prefix + "pos_x", "pos_x", args.name, args.pos.x, -100, 100, 0.1));
-    m_rsScene->addParam(RsFloatParam(prefix + "pos_y", "pos_y", args.name, args.pos.y, -100, 100, 0.1));
-    m_rsScene->addParam(RsFloatParam(prefix + "pos_z", "pos_z", args.name, args.pos.z, -100, 100, 0.1));
-    m_rsScene->addParam(RsFloatParam(prefix + "rot_x", "rot_x", args.name, 0, 0, 359, 1));
-    m_rsScene->addParam(RsFloatParam(prefix + "rot_y", "rot_y", args.name, 0, 0, 359, 1));
-    m_rsScene->addParam(RsFloatParam(prefix + "rot_z", "rot_z", args.name, 0, 0, 359, 1));
-    m_rsScene->addParam(RsFloatParam(prefix + "scale_x", "scale_x", args.name, 1, 0, 10, .01));
-    m_rsScene->addParam(RsFloatParam(prefix + "scale_y", "scale_y", args.name, 1, 0, 10, .01));
-    m_rsScene->addParam(RsFloatParam(prefix + "scale_z", "scale_z", args.name, 1, 0, 10, .01));
+    m_rsScene->addParam(RsFloatParam(prefix + "pos_x", "pos_x", args.name, args.pos.x, -100, 100, 0.1), obj);
+    m_rsScene->addParam(RsFloatParam(prefix + "pos_y", "pos_y", args.name, args.pos.y, -100, 100, 0.1), obj);
+    m_rsScene->addParam(RsFloatParam(prefix + "pos_z", "pos_z", args.name, args.pos.z, -100, 100, 0.1), obj);
+    m_rsScene->addParam(RsFloatParam(prefix + "rot_x", "rot_x", args.name, 0, 0, 359, 1), obj);
+    m_rsScene->addParam(RsFloatParam(prefix + "rot_y", "rot_y", args.name, 0, 0, 359, 1), obj);
+    m_rsScene->addParam(RsFloatParam(prefix + "rot_z", "rot_z", args.name, 0, 0, 359, 1), obj);
+    m_rsScene->addParam(RsFloatParam(prefix + "scale_x", "scale_x", args.name, 1, 0, 10, .01), obj);
+    m_rsScene->addParam(RsFloatParam(prefix + "scale_y", "scale_y", args.name, 1, 0, 10, .01), obj);
+    m_rsScene->addParam(RsFloatParam(prefix + "scale_z", "scale_z", args.name, 1, 0, 10, .01), obj);
 
-    m_rsScene->addParam(RsTextureParam(prefix + "texture", "texture", args.name));
+    m_rsScene->addParam(RsTextureParam(prefix + "texture", "texture", args.name), obj);
 
     App::getSchema().reloadScene(*m_rsScene);
     App::reloadSchema();
@@ -211,26 +386,27 @@ Object* Scene::addObject(ObjectType type, ObjectArgs args){
 
 void Scene::removeObject(Object* obj)
 {
-    m_objects.erase(std::remove(m_objects.begin(), m_objects.end(), obj));
-
+    // the object frees its slot, the last object is moved into it
     m_rsScene->removeParamsForObj(obj);
     delete obj;
+    m_offsetsDirty = true;
 
     App::getSchema().reloadScene(*m_rsScene);
     App::reloadSchema();
 }
 
-unsigned int Scene::getShader(){
-    return m_shader;
-}
-
 Camera* Scene::getCurrentCamera() {
     return m_currentCamera;
 }
 
 const std::vector<Object*>& Scene::getObjects()
 {
-    return m_objects;
+    return m_store.getObjects();
+}
+
+ObjectStore& Scene::getStore()
+{
+    return m_store;
 }
 
 const std::vector<Camera*>& Scene::getCameras()
@@ -240,19 +416,202 @@ const std::vector<Camera*>& Scene::getCameras()
 
 int Scene::getObjectCount()
 {
-    return m_objects.size();
+    return m_store.getCount();
 }
 
 int Scene::getObjectCount(ObjectType type)
 {
     int count = 0;
-    for (Object* o : m_objects)
+    for (Object* o : m_store.getObjects())
         if (o->getType() == type)
             count++;
     return count;
 }
 
+int Scene::getTransformsUpdated()
+{
+    return m_transformsUpdated;
+}
+
+TransformKernel Scene::getTransformKernel()
+{
+    return m_store.getTransforms().getKernel();
+}
+
+int Scene::getImageFetches()
+{
+    return m_imageFetches;
+}
+
+int Scene::getImageFetchesSaved()
+{
+    return m_imageFetchesSaved;
+}
+
+const ParamLayout& Scene::getParamLayout()
+{
+    return m_rsScene->getLayout();
+}
+
+size_t Scene::getParamBytes()
+{
+    return m_rsScene->getStrings().getBytesReserved();
+}
+
+size_t Scene::getParamBytesSaved()
+{
+    return m_rsScene->getStrings().getBytesSaved();
+}
+
 Object* Scene::operator [](int i)
 {
-    return m_objects[i];
+    return m_store.getObject(i);
+}
+
+size_t ObjectStore::add(Object* obj, const std::string& name, glm::vec3 pos, glm::vec3 size)
+{
+    const size_t slot = m_objects.size();
+    m_objects.push_back(obj);
+    m_names.push_back(name);
+    m_meshes.push_back(MeshLods());
+    m_textures.push_back(0);
+    m_numberOffsets.push_back(NO_PARAMS);
+    m_imageOffsets.push_back(NO_PARAMS);
+    m_bounds.push_back(glm::vec4(pos, 0));
+    m_lods.resize(m_lods.size() + m_lodStreams, 0);
+
+    m_transforms.add();
+    m_transforms.setPosition(slot, pos);
+    m_transforms.setSize(slot, size);
+    return slot;
+}
+
+void ObjectStore::remove(size_t slot)
+{
+    const size_t last = m_objects.size() - 1;
+    if (slot != last)
+    {
+        m_objects[slot]         = m_objects[last];
+        m_names[slot].swap(m_names[last]);
+        m_meshes[slot]          = m_meshes[last];
+        m_textures[slot]        = m_textures[last];
+        m_numberOffsets[slot]   = m_numberOffsets[last];
+        m_imageOffsets[slot]    = m_imageOffsets[last];
+        m_bounds[slot]          = m_bounds[last];
+        std::copy(m_lods.begin() + last * m_lodStreams, m_lods.begin() + (last + 1) * m_lodStreams,
+            m_lods.begin() + slot * m_lodStreams);
+        m_objects[slot]->setSlot(slot);
+    }
+
+    m_objects.pop_back();
+    m_names.pop_back();
+    m_meshes.pop_back();
+    m_textures.pop_back();
+    m_numberOffsets.pop_back();
+    m_imageOffsets.pop_back();
+    m_bounds.pop_back();
+    m_lods.resize(m_lods.size() - m_lodStreams);
+    m_transforms.remove(slot);
+}
+
+void ObjectStore::setMeshes(size_t slot, const MeshLods& lods)
+{
+    m_meshes[slot] = lods;
+}
+
+void ObjectStore::setTexture(size_t slot, unsigned int texture)
+{
+    m_textures[slot] = texture;
+}
+
+void ObjectStore::setLodStreams(size_t streams)
+{
+    if (streams == m_lodStreams)
+        return;
+    m_lodStreams = streams;
+    m_lods.assign(m_objects.size() * streams, 0);
+}
+
+void ObjectStore::setParamOffsets(const ParamLayout& layout)
+{
+    std::fill(m_numberOffsets.begin(), m_numberOffsets.end(), NO_PARAMS);
+    std::fill(m_imageOffsets.begin(), m_imageOffsets.end(), NO_PARAMS);
+
+    for (const ParamSlice& slice : layout.slices)
+    {
+        const size_t slot = slice.obj->getSlot();
+        if (slice.numbers >= Param_Count)
+            m_numberOffsets[slot] = slice.number;
+        if (slice.images)
+            m_imageOffsets[slot] = slice.image;
+    }
+}
+
+void ObjectStore::updateBounds()
+{
+    for (size_t slot = 0; slot < m_objects.size(); ++slot)
+    {
+        // the largest scale on any axis, whatever the rotation
+        const glm::mat4& model = m_transforms.getModel(slot);
+        const float scale = std::max(glm::length(glm::vec3(model[0])),
+            std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        VertexArray* mesh = m_meshes[slot].meshes[0];
+        const float radius = mesh ? mesh->getRadius() : 0.f;
+        m_bounds[slot] = glm::vec4(glm::vec3(model[3]), radius * scale);
+    }
+}
+
+size_t ObjectStore::getCount()
+{
+    return m_objects.size();
+}
+
+const std::vector<Object*>& ObjectStore::getObjects()
+{
+    return m_objects;
+}
+
+Object* ObjectStore::getObject(size_t slot)
+{
+    return m_objects[slot];
+}
+
+const char* ObjectStore::getName(size_t slot)
+{
+    return m_names[slot].c_str();
+}
+
+const MeshLods& ObjectStore::getMeshes(size_t slot)
+{
+    return m_meshes[slot];
+}
+
+unsigned int ObjectStore::getTexture(size_t slot)
+{
+    return m_textures[slot];
+}
+
+uint32_t ObjectStore::getNumberOffset(size_t slot)
+{
+    return m_numberOffsets[slot];
+}
+
+uint32_t ObjectStore::getImageOffset(size_t slot)
+{
+    return m_imageOffsets[slot];
+}
+
+const glm::vec4& ObjectStore::getBounds(size_t slot)
+{
+    return m_bounds[slot];
+}
+
+uint8_t& ObjectStore::getLod(size_t slot, size_t stream)
+{
+    return m_lods[slot * m_lodStreams + stream];
+}
+
+TransformStore& ObjectStore::getTransforms()
+{
+    return m_transforms;
 }
@@ -0,0 +1,199 @@
+#include "shader.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#include "utils.hpp"
+
+ShaderProgram::ShaderProgram(const GLchar* vsSrc[], const GLchar* fsSrc[])
+    : m_id (utils::createShader(vsSrc, fsSrc))
+{
+    GLint count = 0;
+    GLint maxLen = 0;
+    glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLen);
+
+    std::vector<GLchar> name(maxLen + 1);
+
+    for (GLint i = 0; i < count; ++i)
+    {
+        Uniform uniform = {};
+        GLsizei len = 0;
+        glGetActiveUniform(m_id, i, name.size(), &len, &uniform.size, &uniform.type, name.data());
+        uniform.location = glGetUniformLocation(m_id, name.data());
+
+        // members of uniform blocks have no location
+        if (uniform.location < 0)
+            continue;
+
+        // arrays are reported as "name[0]", register them by their plain name
+        std::string uniformName(name.data(), len);
+        const size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos)
+            uniformName.resize(bracket);
+
+        m_handles[uniformName] = m_uniforms.size();
+        m_uniforms.push_back(uniform);
+    }
+}
+
+ShaderProgram::~ShaderProgram()
+{
+    glDeleteProgram(m_id);
+}
+
+void ShaderProgram::use()
+{
+    glUseProgram(m_id);
+}
+
+unsigned int ShaderProgram::getId()
+{
+    return m_id;
+}
+
+void ShaderProgram::bindBlock(const std::string& name, GLuint binding)
+{
+    const GLuint index = glGetUniformBlockIndex(m_id, name.c_str());
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(m_id, index, binding);
+}
+
+int ShaderProgram::getUniform(const std::string& name)
+{
+    auto it = m_handles.find(name);
+    if (it == m_handles.end())
+        return -1;
+    return it->second;
+}
+
+bool ShaderProgram::cache(int handle, const void* data, size_t size)
+{
+    Uniform& uniform = m_uniforms[handle];
+    if (uniform.set && !memcmp(uniform.value, data, size))
+        return false;
+    memcpy(uniform.value, data, size);
+    uniform.set = true;
+    return true;
+}
+
+void ShaderProgram::setInt(int handle, int value)
+{
+    if (handle < 0 || !cache(handle, &value, sizeof(value)))
+        return;
+    glUniform1i(m_uniforms[handle].location, value);
+}
+
+void ShaderProgram::setFloat(int handle, float value)
+{
+    if (handle < 0 || !cache(handle, &value, sizeof(value)))
+        return;
+    glUniform1f(m_uniforms[handle].location, value);
+}
+
+void ShaderProgram::setVec3(int handle, const glm::vec3& value)
+{
+    if (handle < 0 || !cache(handle, &value[0], sizeof(value)))
+        return;
+    glUniform3fv(m_uniforms[handle].location, 1, &value[0]);
+}
+
+void ShaderProgram::setVec4(int handle, const glm::vec4& value)
+{
+    if (handle < 0 || !cache(handle, &value[0], sizeof(value)))
+        return;
+    glUniform4fv(m_uniforms[handle].location, 1, &value[0]);
+}
+
+void ShaderProgram::setMat4(int handle, const glm::mat4& value)
+{
+    if (handle < 0 || !cache(handle, &value[0][0], sizeof(value)))
+        return;
+    glUniformMatrix4fv(m_uniforms[handle].location, 1, GL_FALSE, &value[0][0]);
+}
+
+UniformBuffer::UniformBuffer()
+    : m_ubo         (0),
+      m_dirtyBegin  (0),
+      m_dirtyEnd    (0)
+{}
+
+UniformBuffer::~UniformBuffer()
+{
+    if (m_ubo)
+        glDeleteBuffers(1, &m_ubo);
+}
+
+UniformBuffer::Block* UniformBuffer::getBlock(GLuint binding)
+{
+    for (Block& block : m_blocks)
+        if (block.binding == binding)
+            return &block;
+    return nullptr;
+}
+
+void UniformBuffer::addBlock(GLuint binding, size_t size)
+{
+    Block block;
+    block.binding = binding;
+    block.offset = 0;
+    block.size = size;
+    m_blocks.push_back(block);
+}
+
+void UniformBuffer::build()
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    size_t offset = 0;
+    for (Block& block : m_blocks)
+    {
+        block.offset = offset;
+        offset += (block.size + alignment - 1) / alignment * alignment;
+    }
+
+    m_data.assign(offset, 0);
+
+    glGenBuffers(1, &m_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, m_data.size(), m_data.data(), GL_DYNAMIC_DRAW);
+
+    for (const Block& block : m_blocks)
+        glBindBufferRange(GL_UNIFORM_BUFFER, block.binding, m_ubo, block.offset, block.size);
+
+    utils::checkGLError(" building uniform buffer");
+}
+
+void UniformBuffer::write(GLuint binding, const void* data, size_t size)
+{
+    const Block* block = getBlock(binding);
+    if (!block || size > block->size)
+        return;
+
+    uint8_t* dst = &m_data[block->offset];
+    if (!memcmp(dst, data, size))
+        return;
+    memcpy(dst, data, size);
+
+    // grow the dirty range to cover this block
+    if (m_dirtyBegin == m_dirtyEnd)
+    {
+        m_dirtyBegin = block->offset;
+        m_dirtyEnd = block->offset + size;
+        return;
+    }
+    m_dirtyBegin = std::min(m_dirtyBegin, block->offset);
+    m_dirtyEnd = std::max(m_dirtyEnd, block->offset + size);
+}
+
+void UniformBuffer::upload()
+{
+    if (m_dirtyBegin == m_dirtyEnd)
+        return;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, m_dirtyBegin, m_dirtyEnd - m_dirtyBegin, &m_data[m_dirtyBegin]);
+
+    m_dirtyBegin = m_dirtyEnd = 0;
+}
@@ -1,50 +1,60 @@
 #include "shape.hpp"
 #include <GL/glew.h>
 #include <iostream>
+#include <algorithm>
 #include "utils.hpp"
 #include "scene.hpp"
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/vector_angle.hpp>
 #include "app.hpp"
+#include "mesh.hpp"
 
 Cube::Cube(Scene* scene, glm::vec3 pos, float size, const std::string& name, glm::vec3 colour)
     : Object(scene, pos, glm::vec3(size), name)
 {
     m_type = Object_Cube;
-    
-    m_vao.addVertex(v3(-1,  1,  1 ), v2(1, 0), v3(0, 0, 1)); 
-    m_vao.addVertex(v3(-1,  1,  1 ), v2(0, 0), v3(0, 0, 1)); 
-    m_vao.addVertex(v3(-1,  1,  1 ), v2(0, 0), v3(0, 0, 1)); 
 
-    m_vao.addVertex(v3(-1, -1,  1 ), v2(1, 1), v3(0, 0, 1)); 
-    m_vao.addVertex(v3(-1, -1,  1 ), v2(0, 1), v3(0, 0, 1)); 
-    m_vao.addVertex(v3(-1, -1,  1 ), v2(0, 1), v3(0, 0, 1)); 
+    MeshLods lods;
+    lods.keys[0].type = m_type;
+    lods.count = 1;
+    setMeshes(lods, Cube::buildMesh);
+}
+
+void Cube::buildMesh(VertexArray& vao, const MeshKey& /*key*/)
+{
+    vao.addVertex(v3(-1,  1,  1 ), v2(1, 0), v3(0, 0, 1)); 
+    vao.addVertex(v3(-1,  1,  1 ), v2(0, 0), v3(0, 0, 1)); 
+    vao.addVertex(v3(-1,  1,  1 ), v2(0, 0), v3(0, 0, 1)); 
+
+    vao.addVertex(v3(-1, -1,  1 ), v2(1, 1), v3(0, 0, 1)); 
+    vao.addVertex(v3(-1, -1,  1 ), v2(0, 1), v3(0, 0, 1)); 
+    vao.addVertex(v3(-1, -1,  1 ), v2(0, 1), v3(0, 0, 1)); 
 
-    m_vao.addVertex(v3( 1,  1,  1 ), v2(0, 0), v3(1, 0, 0)); 
-    m_vao.addVertex(v3( 1,  1,  1 ), v2(1, 0), v3(1, 0, 0)); 
-    m_vao.addVertex(v3( 1,  1,  1 ), v2(1, 0), v3(1, 0, 0)); 
+    vao.addVertex(v3( 1,  1,  1 ), v2(0, 0), v3(1, 0, 0)); 
+    vao.addVertex(v3( 1,  1,  1 ), v2(1, 0), v3(1, 0, 0)); 
+    vao.addVertex(v3( 1,  1,  1 ), v2(1, 0), v3(1, 0, 0)); 
 
-    m_vao.addVertex(v3( 1,  -1,  1), v2(0, 1), v3(1, 0, 0)); 
-    m_vao.addVertex(v3( 1,  -1,  1), v2(1, 1), v3(1, 0, 0)); 
-    m_vao.addVertex(v3( 1,  -1,  1), v2(1, 1), v3(1, 0, 0)); 
+    vao.addVertex(v3( 1,  -1,  1), v2(0, 1), v3(1, 0, 0)); 
+    vao.addVertex(v3( 1,  -1,  1), v2(1, 1), v3(1, 0, 0)); 
+    vao.addVertex(v3( 1,  -1,  1), v2(1, 1), v3(1, 0, 0)); 
 
-    m_vao.addVertex(v3(-1,  1, -1), v2(1, 0), v3(-1, 0, 0)); 
-    m_vao.addVertex(v3(-1,  1, -1), v2(0, 1), v3(-1, 0, 0)); 
-    m_vao.addVertex(v3(-1,  1, -1), v2(0, 0), v3(-1, 0, 0)); 
+    vao.addVertex(v3(-1,  1, -1), v2(1, 0), v3(-1, 0, 0)); 
+    vao.addVertex(v3(-1,  1, -1), v2(0, 1), v3(-1, 0, 0)); 
+    vao.addVertex(v3(-1,  1, -1), v2(0, 0), v3(-1, 0, 0)); 
 
-    m_vao.addVertex(v3(-1, -1, -1), v2(1, 1), v3(0, 0, -1)); 
-    m_vao.addVertex(v3(-1, -1, -1), v2(0, 1), v3(0, 0, -1)); 
-    m_vao.addVertex(v3(-1, -1, -1), v2(0, 0), v3(0, 0, -1)); 
+    vao.addVertex(v3(-1, -1, -1), v2(1, 1), v3(0, 0, -1)); 
+    vao.addVertex(v3(-1, -1, -1), v2(0, 1), v3(0, 0, -1)); 
+    vao.addVertex(v3(-1, -1, -1), v2(0, 0), v3(0, 0, -1)); 
 
-    m_vao.addVertex(v3( 1,  1, -1 ), v2(1, 1), v3(0, 1, 0));
-    m_vao.addVertex(v3( 1,  1, -1 ), v2(1, 0), v3(0, 1, 0)); 
-    m_vao.addVertex(v3( 1,  1, -1 ), v2(0, 0), v3(0, 1, 0)); 
+    vao.addVertex(v3( 1,  1, -1 ), v2(1, 1), v3(0, 1, 0));
+    vao.addVertex(v3( 1,  1, -1 ), v2(1, 0), v3(0, 1, 0)); 
+    vao.addVertex(v3( 1,  1, -1 ), v2(0, 0), v3(0, 1, 0)); 
 
-    m_vao.addVertex(v3( 1, -1, -1), v2(1, 1), v3(0, 0, -1)); 
-    m_vao.addVertex(v3( 1, -1, -1), v2(0, 1), v3(0, 0, -1)); 
-    m_vao.addVertex(v3( 1, -1, -1), v2(1, 0), v3(0, 0, -1)); 
+    vao.addVertex(v3( 1, -1, -1), v2(1, 1), v3(0, 0, -1)); 
+    vao.addVertex(v3( 1, -1, -1), v2(0, 1), v3(0, 0, -1)); 
+    vao.addVertex(v3( 1, -1, -1), v2(1, 0), v3(0, 0, -1)); 
 
-    m_vao.setIndices({
+    vao.setIndices({
         0, 6, 9, 0, 9, 3,
         1, 4, 15, 1, 12, 15,
         2, 7, 18, 2, 13, 18,
@@ -52,8 +62,6 @@ Cube::Cube(Scene* scene, glm::vec3 pos, float size, const std::string& name, glm
         10, 8, 20, 10, 22, 20,
         11, 5, 17, 11, 23, 17
     });
-
-    m_vao.build();
 }
 
 Sphere::Sphere(Scene* scene, glm::vec3 pos, float radius, const std::string& name, int stackCount, int sectorCount, glm::vec3 colour)
@@ -62,13 +70,38 @@ Sphere::Sphere(Scene* scene, glm::vec3 pos, float radius, const std::string& nam
       m_sectorCount		(sectorCount)
 {
     m_type = Object_Sphere;
+    updateMeshes();
+}
+
+void Sphere::updateMeshes()
+{
+    MeshLods lods;
+    for (int i = 0; i < MESH_LODS; ++i)
+    {
+        MeshKey& key = lods.keys[i];
+        key.type = m_type;
+        key.stackCount = std::max(m_stackCount >> i, std::min(m_stackCount, SPHERE_MIN_STACKS));
+        key.sectorCount = std::max(m_sectorCount >> i, std::min(m_sectorCount, SPHERE_MIN_SECTORS));
+
+        // already as coarse as it gets
+        if (i && key.stackCount == lods.keys[i - 1].stackCount && key.sectorCount == lods.keys[i - 1].sectorCount)
+            break;
+        lods.count = i + 1;
+    }
+    setMeshes(lods, Sphere::buildMesh);
+}
+
+void Sphere::buildMesh(VertexArray& vao, const MeshKey& key)
+{
+    const int stackCount = key.stackCount;
+    const int sectorCount = key.sectorCount;
 
     int stackIt = 0;
     int	secIt = 0;
-    float stackStep = PI / m_stackCount;
-    float sectorStep = 2 * PI / m_sectorCount;
+    float stackStep = PI / stackCount;
+    float sectorStep = 2 * PI / sectorCount;
 
-    while (stackIt <= m_stackCount) {
+    while (stackIt <= stackCount) {
         float stackAngle = PI / 2 - stackIt * stackStep;
         float sectorAngle = secIt * sectorStep;
 
@@ -82,13 +115,13 @@ Sphere::Sphere(Scene* scene, glm::vec3 pos, float radius, const std::string& nam
 
         // tex coords
         v2 texCoord(
-            (float)secIt / m_sectorCount,
-            (float)stackIt / m_stackCount
+            (float)secIt / sectorCount,
+            (float)stackIt / stackCount
         );
 
-        m_vao.addVertex(pos, texCoord, normal);
+        vao.addVertex(pos, texCoord, normal);
 
-        if (secIt == m_sectorCount) {
+        if (secIt == sectorCount) {
             secIt = 0;
             stackIt++;
             continue;
@@ -99,30 +132,28 @@ Sphere::Sphere(Scene* scene, glm::vec3 pos, float radius, const std::string& nam
 
     stackIt = 0;
 
-    while (stackIt < m_stackCount) {
-        int stackBegin = stackIt * (m_sectorCount + 1);
-        int nextStack = stackBegin + m_sectorCount + 1;
+    while (stackIt < stackCount) {
+        int stackBegin = stackIt * (sectorCount + 1);
+        int nextStack = stackBegin + sectorCount + 1;
 
-        for (int j = 0; j < m_sectorCount; ++j, ++stackBegin, ++nextStack)
+        for (int j = 0; j < sectorCount; ++j, ++stackBegin, ++nextStack)
         {
             if (stackIt)
             {
-                m_vao.addIndex(stackBegin);
-                m_vao.addIndex(nextStack);
-                m_vao.addIndex(stackBegin + 1);
+                vao.addIndex(stackBegin);
+                vao.addIndex(nextStack);
+                vao.addIndex(stackBegin + 1);
             }
 
-            if (stackIt != m_stackCount - 1)
+            if (stackIt != stackCount - 1)
             {
-                m_vao.addIndex(stackBegin + 1);
-                m_vao.addIndex(nextStack);
-                m_vao.addIndex(nextStack + 1);
+                vao.addIndex(stackBegin + 1);
+                vao.addIndex(nextStack);
+                vao.addIndex(nextStack + 1);
             }
         }
         stackIt++;
     }
-
-    m_vao.build();
 }
 
 int Sphere::getStacks() {
@@ -131,6 +162,7 @@ int Sphere::getStacks() {
 
 void Sphere::setStacks(int count) {
     m_stackCount = count;
+    updateMeshes();
 }
 
 int Sphere::getSectors() {
@@ -138,4 +170,6 @@ int Sphere::getSectors() {
 }
 
 void Sphere::setSectors(int count) {
+    m_sectorCount = count;
+    updateMeshes();
 }
\ No newline at end of file
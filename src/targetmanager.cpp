@@ -0,0 +1,235 @@
+#include "targetmanager.hpp"
+
+#include <algorithm>
+
+TargetManager::TargetManager() : m_bytes (0), m_made (0), m_freed (0), m_kept (0), m_maxSamples (0) {}
+
+void TargetManager::create(RenderTarget& target, const TextureKey& key, int samples, bool blitOnly)
+{
+    const GLenum format = utils::glInternalFormat(key.format);
+
+    glGenTextures(1, &target.texture);
+    utils::checkGLError(" generating tex");
+    glBindTexture(GL_TEXTURE_2D, target.texture);
+    utils::checkGLError(" binding texture");
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, format, key.width, key.height,
+                                0, utils::glFormat(key.format), utils::glType(key.format), nullptr);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    GLenum bufs[] = { GL_COLOR_ATTACHMENT0 };
+    // kept on blit only targets too, streams are only shared between targets with the same samples
+    target.samples = samples;
+
+    glGenFramebuffers(1, &target.frameBuf);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.frameBuf);
+
+    if (!blitOnly)
+    {
+        glGenRenderbuffers(1, &target.depthBuf);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depthBuf);
+        if (samples > 1)
+            glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, key.width, key.height);
+        else
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, key.width, key.height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthBuf);
+    }
+
+    if (samples > 1 && !blitOnly)
+    {
+        // the stream is drawn multisampled, and only the resolved image goes into the texture
+        glGenRenderbuffers(1, &target.colourBuf);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.colourBuf);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, format, key.width, key.height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colourBuf);
+        glDrawBuffers(1, bufs);
+
+        glGenFramebuffers(1, &target.resolveBuf);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.resolveBuf);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.texture, 0);
+    }
+    else
+    {
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target.texture, 0);
+    }
+
+    glDrawBuffers(1, bufs);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    utils::checkGLError(" creating stream target");
+
+    m_bytes += getBytes(key, target);
+    m_made++;
+}
+
+void TargetManager::destroy(RenderTarget& target, const TextureKey& key)
+{
+    m_bytes -= getBytes(key, target);
+
+    // deleting 0 is ignored, for the buffers only some targets have
+    glDeleteFramebuffers(1, &target.frameBuf);
+    glDeleteFramebuffers(1, &target.resolveBuf);
+    glDeleteRenderbuffers(1, &target.depthBuf);
+    glDeleteRenderbuffers(1, &target.colourBuf);
+    glDeleteTextures(1, &target.texture);
+
+    target = RenderTarget();
+    m_freed++;
+}
+
+size_t TargetManager::getBytes(const TextureKey& key, const RenderTarget& target)
+{
+    // 24 bit depth is padded to 32 by every driver we've seen. multisampled
+    // buffers hold every sample, on top of the resolved texture
+    const size_t pixels = (size_t)key.width * key.height;
+    const size_t colour = TexturePool::getBytesPerPixel(key.format);
+    const size_t samples = std::max(target.samples, 1);
+    size_t bytes = pixels * colour;
+    if (target.depthBuf)
+        bytes += pixels * samples * 4;
+    if (target.colourBuf)
+        bytes += pixels * samples * colour;
+    return bytes;
+}
+
+bool TargetManager::update(const StreamDescriptions* header, int depth, const std::vector<int>& samples, bool scaling)
+{
+    if (!m_maxSamples)
+        glGetIntegerv(GL_MAX_SAMPLES, &m_maxSamples);
+
+    m_made = 0;
+    m_freed = 0;
+    m_kept = 0;
+
+    for (auto& stream : m_streams)
+        stream.second.seen = false;
+
+    const size_t nStreams = header ? header->nStreams : 0;
+    for (size_t i = 0; i < nStreams; ++i)
+    {
+        const StreamDescription& desc = header->streams[i];
+        TextureKey key;
+        key.width = desc.width;
+        key.height = desc.height;
+        key.format = desc.format;
+
+        const int streamSamples = std::min(i < samples.size() ? samples[i] : 1, std::max(m_maxSamples, 1));
+
+        Entry& entry = m_streams[desc.handle];
+        entry.seen = true;
+        std::vector<RenderTarget>& buffers = entry.targets.buffers;
+        std::vector<RenderTarget>& scaled = entry.targets.scaled;
+
+        // a new size, format or sample count needs all new targets, and so does turning
+        // scaling on or off, as the buffers are only blitted into while it's on
+        if (entry.key != key || entry.samples != streamSamples || entry.scaling != scaling)
+        {
+            for (RenderTarget& target : buffers)
+                destroy(target, entry.key);
+            buffers.clear();
+            for (RenderTarget& target : scaled)
+                destroy(target, entry.key);
+            scaled.clear();
+            entry.key = key;
+            entry.samples = streamSamples;
+            entry.scaling = scaling;
+        }
+
+        // a new queue depth only adds or drops targets at the end. each buffer has its
+        // own scaled target, so one isn't drawn into while an earlier frame's upscale
+        // from it may still be running on another context
+        while (buffers.size() > (size_t)depth)
+        {
+            destroy(buffers.back(), key);
+            buffers.pop_back();
+            if (scaling)
+            {
+                destroy(scaled.back(), key);
+                scaled.pop_back();
+            }
+        }
+        m_kept += buffers.size() + scaled.size();
+
+        while (buffers.size() < (size_t)depth)
+        {
+            buffers.push_back(RenderTarget());
+            create(buffers.back(), key, streamSamples, scaling);
+            if (scaling)
+            {
+                scaled.push_back(RenderTarget());
+                create(scaled.back(), key, streamSamples, false);
+            }
+        }
+        entry.targets.next = 0;
+    }
+
+    for (auto it = m_streams.begin(); it != m_streams.end();)
+    {
+        if (it->second.seen)
+        {
+            ++it;
+            continue;
+        }
+
+        for (RenderTarget& target : it->second.targets.buffers)
+            destroy(target, it->second.key);
+        for (RenderTarget& target : it->second.targets.scaled)
+            destroy(target, it->second.key);
+        it = m_streams.erase(it);
+    }
+
+    return m_made || m_freed;
+}
+
+void TargetManager::clear()
+{
+    for (auto& stream : m_streams)
+    {
+        for (RenderTarget& target : stream.second.targets.buffers)
+            destroy(target, stream.second.key);
+        for (RenderTarget& target : stream.second.targets.scaled)
+            destroy(target, stream.second.key);
+    }
+    m_streams.clear();
+}
+
+StreamTargets& TargetManager::get(StreamHandle handle)
+{
+    return m_streams.at(handle).targets;
+}
+
+int TargetManager::getTargetCount()
+{
+    int count = 0;
+    for (auto& stream : m_streams)
+        count += stream.second.targets.buffers.size() + stream.second.targets.scaled.size();
+    return count;
+}
+
+size_t TargetManager::getBytes()
+{
+    return m_bytes;
+}
+
+int TargetManager::getMade()
+{
+    return m_made;
+}
+
+int TargetManager::getFreed()
+{
+    return m_freed;
+}
+
+int TargetManager::getKept()
+{
+    return m_kept;
+}
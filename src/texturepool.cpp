@@ -0,0 +1,91 @@
+#include "texturepool.hpp"
+
+#include "utils.hpp"
+
+std::map<TextureKey, TexturePool::Entry> TexturePool::s_textures;
+int TexturePool::s_total = 0;
+int TexturePool::s_used = 0;
+size_t TexturePool::s_bytes = 0;
+
+// free textures kept per key, past this they're deleted on release so a size
+// that is no longer used doesn't hold on to memory
+static const size_t MAX_FREE = 4;
+
+GLuint TexturePool::acquire(const TextureKey& key)
+{
+    Entry& entry = s_textures[key];
+    ++entry.used;
+    ++s_used;
+
+    if (!entry.free.empty())
+    {
+        const GLuint texture = entry.free.back();
+        entry.free.pop_back();
+        return texture;
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexStorage2D(GL_TEXTURE_2D, 1, utils::glInternalFormat(key.format), key.width, key.height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    utils::checkGLError(" allocating pooled texture");
+
+    ++s_total;
+    s_bytes += (size_t)key.width * key.height * getBytesPerPixel(key.format);
+
+    return texture;
+}
+
+void TexturePool::release(const TextureKey& key, GLuint texture)
+{
+    auto it = s_textures.find(key);
+    if (it == s_textures.end())
+        return;
+
+    Entry& entry = it->second;
+    --entry.used;
+    --s_used;
+
+    if (entry.free.size() < MAX_FREE)
+    {
+        entry.free.push_back(texture);
+        return;
+    }
+
+    glDeleteTextures(1, &texture);
+    --s_total;
+    s_bytes -= (size_t)key.width * key.height * getBytesPerPixel(key.format);
+}
+
+int TexturePool::getUsedCount()
+{
+    return s_used;
+}
+
+int TexturePool::getTotalCount()
+{
+    return s_total;
+}
+
+size_t TexturePool::getBytes()
+{
+    return s_bytes;
+}
+
+size_t TexturePool::getBytesPerPixel(RSPixelFormat format)
+{
+    switch (format)
+    {
+    case RS_FMT_RGBA32F:
+        return 16;
+    case RS_FMT_RGBA16:
+        return 8;
+    default:
+        return 4;
+    }
+}
@@ -0,0 +1,454 @@
+#include "transforms.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/euler_angles.hpp>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RSTEST_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// msvc lets any function use avx2 intrinsics
+#define RSTEST_TARGET_AVX2
+#else
+#define RSTEST_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+static const char* s_kernelNames[] = { "scalar", "sse", "avx2" };
+
+// position, rotation and scale are swizzled from d3's axes the same way
+// for every kernel, rotation is in degrees
+template<typename Columns>
+static glm::vec3 loadPosition(const Columns& columns, size_t i)
+{
+    return glm::vec3(columns[Param_PosZ][i], -columns[Param_PosY][i], columns[Param_PosX][i]);
+}
+
+template<typename Columns>
+static glm::vec3 loadSize(const Columns& columns, size_t i)
+{
+    return glm::vec3(columns[Param_ScaleX][i], columns[Param_ScaleY][i], columns[Param_ScaleZ][i]);
+}
+
+static void buildScalar(const float* const* columns, size_t first, size_t count, glm::mat4* out)
+{
+    for (size_t i = first; i < first + count; ++i)
+    {
+        const glm::mat4 rotation = glm::eulerAngleXYZ(glm::radians(-columns[Param_RotZ][i]),
+            glm::radians(columns[Param_RotX][i]), glm::radians(-columns[Param_RotY][i]));
+
+        out[i] = glm::translate(glm::mat4(1.0f), loadPosition(columns, i))
+            * rotation
+            * glm::scale(glm::mat4(1.0f), loadSize(columns, i));
+    }
+}
+
+#ifdef RSTEST_SIMD_X86
+
+// the simd kernels write out glm::eulerAngleXYZ(-z, x, -y) by hand. with
+// glm's sin(-t) that leaves s1 = sin z, s2 = -sin x, s3 = sin y, and
+//   col0 = sx * (c2c3, -c1s3 + s1s2c3, s1s3 + c1s2c3)
+//   col1 = sy * (c2s3, c1c3 + s1s2s3, -s1c3 + c1s2s3)
+//   col2 = sz * (-s2, s1c2, c1c2)
+// sin and cos are cephes' single precision polynomials, after reducing the
+// angle to [-pi/4, pi/4] and picking the quadrant from the reduction
+
+#define DEG_TO_RAD 0.01745329251994329577f
+#define TWO_OVER_PI 0.63661977236758134308f
+#define PIO2_1 1.5703125f
+#define PIO2_2 4.837512969970703125e-4f
+#define PIO2_3 7.54978995489188216e-8f
+#define SIN_0 -1.9515295891e-4f
+#define SIN_1 8.3321608736e-3f
+#define SIN_2 -1.6666654611e-1f
+#define COS_0 2.443315711809948e-5f
+#define COS_1 -1.388731625493765e-3f
+#define COS_2 4.166664568298827e-2f
+
+static inline void sinCosSse(__m128 degrees, __m128& sin, __m128& cos)
+{
+    const __m128 x = _mm_mul_ps(degrees, _mm_set1_ps(DEG_TO_RAD));
+    const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+    const __m128 j = _mm_cvtepi32_ps(quadrant);
+
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(PIO2_1)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PIO2_2)));
+    r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PIO2_3)));
+    const __m128 z = _mm_mul_ps(r, r);
+
+    __m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_0), z), _mm_set1_ps(SIN_1));
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(SIN_2));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), r), r);
+
+    __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_0), z), _mm_set1_ps(COS_1));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(COS_2));
+    c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+    c = _mm_add_ps(_mm_sub_ps(c, _mm_mul_ps(z, _mm_set1_ps(.5f))), _mm_set1_ps(1.f));
+
+    // odd quadrants swap sin and cos, the second bit of the quadrant
+    // (of quadrant + 1 for cos) is the sign
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i two = _mm_set1_epi32(2);
+    const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+    const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+    const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+
+    sin = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sinSign);
+    cos = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosSign);
+}
+
+static void buildSse(const float* const* columns, size_t first, size_t count, glm::mat4* out)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+
+    for (size_t i = first; i < first + count; i += 4)
+    {
+        __m128 s1, c1, s2, c2, s3, c3;
+        sinCosSse(_mm_loadu_ps(columns[Param_RotZ] + i), s1, c1);
+        sinCosSse(_mm_loadu_ps(columns[Param_RotX] + i), s2, c2);
+        sinCosSse(_mm_loadu_ps(columns[Param_RotY] + i), s3, c3);
+        s2 = _mm_sub_ps(zero, s2);
+
+        const __m128 sx = _mm_loadu_ps(columns[Param_ScaleX] + i);
+        const __m128 sy = _mm_loadu_ps(columns[Param_ScaleY] + i);
+        const __m128 sz = _mm_loadu_ps(columns[Param_ScaleZ] + i);
+        const __m128 s1s2 = _mm_mul_ps(s1, s2);
+        const __m128 c1s2 = _mm_mul_ps(c1, s2);
+
+        // one register per matrix element, four objects in each
+        __m128 m[4][4];
+        m[0][0] = _mm_mul_ps(sx, _mm_mul_ps(c2, c3));
+        m[0][1] = _mm_mul_ps(sx, _mm_sub_ps(_mm_mul_ps(s1s2, c3), _mm_mul_ps(c1, s3)));
+        m[0][2] = _mm_mul_ps(sx, _mm_add_ps(_mm_mul_ps(s1, s3), _mm_mul_ps(c1s2, c3)));
+        m[0][3] = zero;
+        m[1][0] = _mm_mul_ps(sy, _mm_mul_ps(c2, s3));
+        m[1][1] = _mm_mul_ps(sy, _mm_add_ps(_mm_mul_ps(c1, c3), _mm_mul_ps(s1s2, s3)));
+        m[1][2] = _mm_mul_ps(sy, _mm_sub_ps(_mm_mul_ps(c1s2, s3), _mm_mul_ps(s1, c3)));
+        m[1][3] = zero;
+        m[2][0] = _mm_mul_ps(sz, _mm_sub_ps(zero, s2));
+        m[2][1] = _mm_mul_ps(sz, _mm_mul_ps(s1, c2));
+        m[2][2] = _mm_mul_ps(sz, _mm_mul_ps(c1, c2));
+        m[2][3] = zero;
+        m[3][0] = _mm_loadu_ps(columns[Param_PosZ] + i);
+        m[3][1] = _mm_sub_ps(zero, _mm_loadu_ps(columns[Param_PosY] + i));
+        m[3][2] = _mm_loadu_ps(columns[Param_PosX] + i);
+        m[3][3] = one;
+
+        // transposing each column gives it for each object
+        for (int col = 0; col < 4; ++col)
+        {
+            _MM_TRANSPOSE4_PS(m[col][0], m[col][1], m[col][2], m[col][3]);
+            for (int obj = 0; obj < 4; ++obj)
+                _mm_storeu_ps(&out[i + obj][col][0], m[col][obj]);
+        }
+    }
+}
+
+RSTEST_TARGET_AVX2
+static inline void sinCosAvx2(__m256 degrees, __m256& sin, __m256& cos)
+{
+    const __m256 x = _mm256_mul_ps(degrees, _mm256_set1_ps(DEG_TO_RAD));
+    const __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+    const __m256 j = _mm256_cvtepi32_ps(quadrant);
+
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(PIO2_1)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PIO2_2)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PIO2_3)));
+    const __m256 z = _mm256_mul_ps(r, r);
+
+    __m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN_0), z), _mm256_set1_ps(SIN_1));
+    s = _mm256_add_ps(_mm256_mul_ps(s, z), _mm256_set1_ps(SIN_2));
+    s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, z), r), r);
+
+    __m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COS_0), z), _mm256_set1_ps(COS_1));
+    c = _mm256_add_ps(_mm256_mul_ps(c, z), _mm256_set1_ps(COS_2));
+    c = _mm256_mul_ps(_mm256_mul_ps(c, z), z);
+    c = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(z, _mm256_set1_ps(.5f))), _mm256_set1_ps(1.f));
+
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+    const __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+    const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+
+    sin = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sinSign);
+    cos = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosSign);
+}
+
+// turns eight registers of eight objects into eight registers of one object each
+RSTEST_TARGET_AVX2
+static inline void transpose8(__m256* r)
+{
+    const __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+    const __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    const __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+    const __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    const __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+    const __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    const __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+    const __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+    const __m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44);
+    const __m256 u1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    const __m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44);
+    const __m256 u3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    const __m256 u4 = _mm256_shuffle_ps(t4, t6, 0x44);
+    const __m256 u5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+    const __m256 u6 = _mm256_shuffle_ps(t5, t7, 0x44);
+    const __m256 u7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+
+    r[0] = _mm256_permute2f128_ps(u0, u4, 0x20);
+    r[1] = _mm256_permute2f128_ps(u1, u5, 0x20);
+    r[2] = _mm256_permute2f128_ps(u2, u6, 0x20);
+    r[3] = _mm256_permute2f128_ps(u3, u7, 0x20);
+    r[4] = _mm256_permute2f128_ps(u0, u4, 0x31);
+    r[5] = _mm256_permute2f128_ps(u1, u5, 0x31);
+    r[6] = _mm256_permute2f128_ps(u2, u6, 0x31);
+    r[7] = _mm256_permute2f128_ps(u3, u7, 0x31);
+}
+
+RSTEST_TARGET_AVX2
+static void buildAvx2(const float* const* columns, size_t first, size_t count, glm::mat4* out)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+
+    for (size_t i = first; i < first + count; i += 8)
+    {
+        __m256 s1, c1, s2, c2, s3, c3;
+        sinCosAvx2(_mm256_loadu_ps(columns[Param_RotZ] + i), s1, c1);
+        sinCosAvx2(_mm256_loadu_ps(columns[Param_RotX] + i), s2, c2);
+        sinCosAvx2(_mm256_loadu_ps(columns[Param_RotY] + i), s3, c3);
+        s2 = _mm256_sub_ps(zero, s2);
+
+        const __m256 sx = _mm256_loadu_ps(columns[Param_ScaleX] + i);
+        const __m256 sy = _mm256_loadu_ps(columns[Param_ScaleY] + i);
+        const __m256 sz = _mm256_loadu_ps(columns[Param_ScaleZ] + i);
+        const __m256 s1s2 = _mm256_mul_ps(s1, s2);
+        const __m256 c1s2 = _mm256_mul_ps(c1, s2);
+
+        // the first two columns of every object, then the last two
+        __m256 lo[8];
+        lo[0] = _mm256_mul_ps(sx, _mm256_mul_ps(c2, c3));
+        lo[1] = _mm256_mul_ps(sx, _mm256_sub_ps(_mm256_mul_ps(s1s2, c3), _mm256_mul_ps(c1, s3)));
+        lo[2] = _mm256_mul_ps(sx, _mm256_add_ps(_mm256_mul_ps(s1, s3), _mm256_mul_ps(c1s2, c3)));
+        lo[3] = zero;
+        lo[4] = _mm256_mul_ps(sy, _mm256_mul_ps(c2, s3));
+        lo[5] = _mm256_mul_ps(sy, _mm256_add_ps(_mm256_mul_ps(c1, c3), _mm256_mul_ps(s1s2, s3)));
+        lo[6] = _mm256_mul_ps(sy, _mm256_sub_ps(_mm256_mul_ps(c1s2, s3), _mm256_mul_ps(s1, c3)));
+        lo[7] = zero;
+
+        __m256 hi[8];
+        hi[0] = _mm256_mul_ps(sz, _mm256_sub_ps(zero, s2));
+        hi[1] = _mm256_mul_ps(sz, _mm256_mul_ps(s1, c2));
+        hi[2] = _mm256_mul_ps(sz, _mm256_mul_ps(c1, c2));
+        hi[3] = zero;
+        hi[4] = _mm256_loadu_ps(columns[Param_PosZ] + i);
+        hi[5] = _mm256_sub_ps(zero, _mm256_loadu_ps(columns[Param_PosY] + i));
+        hi[6] = _mm256_loadu_ps(columns[Param_PosX] + i);
+        hi[7] = one;
+
+        transpose8(lo);
+        transpose8(hi);
+
+        for (int obj = 0; obj < 8; ++obj)
+        {
+            _mm256_storeu_ps(&out[i + obj][0][0], lo[obj]);
+            _mm256_storeu_ps(&out[i + obj][2][0], hi[obj]);
+        }
+    }
+}
+
+static bool hasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // the os has to save the ymm registers too
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+namespace transforms {
+
+    BuildFn getKernel(TransformKernel kernel)
+    {
+        switch (kernel)
+        {
+        case Kernel_Scalar:
+            return buildScalar;
+#ifdef RSTEST_SIMD_X86
+        case Kernel_Sse:
+            return buildSse;
+        case Kernel_Avx2:
+            return hasAvx2() ? buildAvx2 : nullptr;
+#endif
+        default:
+            return nullptr;
+        }
+    }
+
+    TransformKernel getBestKernel()
+    {
+        static const TransformKernel best = getKernel(Kernel_Avx2) ? Kernel_Avx2
+            : getKernel(Kernel_Sse) ? Kernel_Sse : Kernel_Scalar;
+        return best;
+    }
+
+    const char* getKernelName(TransformKernel kernel)
+    {
+        return s_kernelNames[kernel];
+    }
+
+}
+
+TransformStore::TransformStore()
+    : m_count   (0),
+      m_kernel  (transforms::getBestKernel()),
+      m_build   (transforms::getKernel(m_kernel))
+{}
+
+size_t TransformStore::add()
+{
+    const size_t i = m_count++;
+
+    // grow a block at a time so the kernels always have whole blocks to work on
+    if (m_count > m_models.size())
+    {
+        const size_t padded = m_models.size() + TRANSFORM_BLOCK;
+        for (std::vector<float>& column : m_columns)
+            column.resize(padded, 0.f);
+        m_models.resize(padded);
+        m_dirtyBlocks.resize(padded / TRANSFORM_BLOCK, 0);
+    }
+
+    for (int j = 0; j < Param_Count; ++j)
+        m_columns[j][i] = j >= Param_ScaleX ? 1.f : 0.f;
+    m_dirtyBlocks[i / TRANSFORM_BLOCK] = 1;
+    return i;
+}
+
+void TransformStore::remove(size_t i)
+{
+    const size_t last = --m_count;
+    if (i != last)
+    {
+        for (std::vector<float>& column : m_columns)
+            column[i] = column[last];
+        m_models[i] = m_models[last];
+
+        // the last object may not have been built yet
+        if (m_dirtyBlocks[last / TRANSFORM_BLOCK])
+            m_dirtyBlocks[i / TRANSFORM_BLOCK] = 1;
+    }
+}
+
+bool TransformStore::write(size_t i, int first, const float* values, int count)
+{
+    bool changed = false;
+    for (int j = 0; j < count; ++j)
+    {
+        float& value = m_columns[first + j][i];
+        if (value != values[j])
+        {
+            value = values[j];
+            changed = true;
+        }
+    }
+
+    if (changed)
+        m_dirtyBlocks[i / TRANSFORM_BLOCK] = 1;
+    return changed;
+}
+
+bool TransformStore::set(size_t i, const float* params)
+{
+    return write(i, 0, params, Param_Count);
+}
+
+void TransformStore::setPosition(size_t i, glm::vec3 pos)
+{
+    // loadPosition backwards
+    const float values[] = { pos.z, -pos.y, pos.x };
+    write(i, Param_PosX, values, 3);
+}
+
+void TransformStore::setSize(size_t i, glm::vec3 size)
+{
+    const float values[] = { size.x, size.y, size.z };
+    write(i, Param_ScaleX, values, 3);
+}
+
+void TransformStore::setRotation(size_t i, float x, float y, float z)
+{
+    // the kernels build eulerAngleXYZ(-rot z, rot x, -rot y)
+    const float values[] = { y, -z, -x };
+    write(i, Param_RotX, values, 3);
+}
+
+void TransformStore::build()
+{
+    const float* columns[Param_Count];
+    for (int i = 0; i < Param_Count; ++i)
+        columns[i] = m_columns[i].data();
+
+    // neighbouring dirty blocks go to the kernel together
+    size_t block = 0;
+    while (block < m_dirtyBlocks.size())
+    {
+        if (!m_dirtyBlocks[block])
+        {
+            ++block;
+            continue;
+        }
+
+        size_t end = block;
+        while (end < m_dirtyBlocks.size() && m_dirtyBlocks[end])
+            m_dirtyBlocks[end++] = 0;
+
+        m_build(columns, block * TRANSFORM_BLOCK, (end - block) * TRANSFORM_BLOCK, m_models.data());
+        block = end;
+    }
+}
+
+const glm::mat4& TransformStore::getModel(size_t i)
+{
+    return m_models[i];
+}
+
+glm::vec3 TransformStore::getPosition(size_t i)
+{
+    return loadPosition(m_columns, i);
+}
+
+glm::vec3 TransformStore::getSize(size_t i)
+{
+    return loadSize(m_columns, i);
+}
+
+size_t TransformStore::getCount()
+{
+    return m_count;
+}
+
+TransformKernel TransformStore::getKernel()
+{
+    return m_kernel;
+}
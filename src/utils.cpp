@@ -5,10 +5,11 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
-#include <windows.h>
 #include <locale>
 #include <codecvt>
+#include <cstring>
 #include <sstream>
+#include <mutex>
 
 #include "scene.hpp"
 #include "app.hpp"
@@ -28,6 +29,38 @@ namespace utils {
     decltype(rs_getFrameImageData)* rsGetFrameImageData;
     decltype(rs_getFrameImage2)* rsGetFrameImage;
 
+    static std::mutex s_rsMutex;
+
+// FN keeps what it pointed at in its own static, captureless lambdas convert to function pointers
+#define SERIALISE_FN(FN) \
+    { \
+        static decltype(FN) unlocked; \
+        unlocked = FN; \
+        FN = [](auto... args) { std::lock_guard<std::mutex> lock(s_rsMutex); return unlocked(args...); }; \
+    }
+
+    void serialiseRsCalls()
+    {
+        static bool serialised = false;
+        if (serialised)
+            return;
+        serialised = true;
+
+        SERIALISE_FN(rsInitialiseGpuOpenGl);
+        SERIALISE_FN(rsGetStreams);
+        SERIALISE_FN(rsSendFrame);
+        SERIALISE_FN(rsGetFrameCamera);
+        SERIALISE_FN(rsAwaitFrameData);
+        SERIALISE_FN(logToD3);
+        SERIALISE_FN(rsShutdown);
+        SERIALISE_FN(rsSetSchema);
+        SERIALISE_FN(rsGetFrameParams);
+        SERIALISE_FN(rsGetFrameImageData);
+        SERIALISE_FN(rsGetFrameImage);
+    }
+
+#undef SERIALISE_FN
+
     const std::string rsErrorStrs[] = {
            "RS_ERROR_SUCCESS",
            "RS_NOT_INITIALISED",
@@ -51,7 +84,11 @@ namespace utils {
     int error(const std::string& msg)
     {
         if (logToD3) logToD3(msg.c_str());
+#ifdef _WIN32
         MessageBoxA(NULL, msg.c_str(), "RsTest Error :(", MB_OK);
+#else
+        std::cerr << msg << std::endl;
+#endif
         return 1;
     }
 
@@ -241,7 +278,7 @@ void RsSchema::addScene(RsScene& scene)
 void RsSchema::removeScene(const RsScene& scene)
 {
     m_scenes.erase(std::remove_if(m_scenes.begin(), m_scenes.end(), 
-        [scene](const RemoteParameters& s) { return s.name == scene.name; }));
+        [&scene](const RemoteParameters& s) { return s.name == scene.name; }));
     scenes.scenes = &m_scenes[0];
     --scenes.nScenes;
 }
@@ -254,35 +291,285 @@ void RsSchema::reloadScene(RsScene& scene)
     scenes.scenes = &m_scenes[0];
 }
 
-RsScene::RsScene()
+size_t StringArena::StrHash::operator()(const char* str) const
+{
+    // fnv-1a
+    size_t hash = 2166136261u;
+    for (; *str; ++str)
+        hash = (hash ^ (unsigned char)*str) * 16777619u;
+    return hash;
+}
+
+bool StringArena::StrEqual::operator()(const char* a, const char* b) const
+{
+    return !strcmp(a, b);
+}
+
+StringArena::StringArena() : m_blockUsed    (BLOCK_SIZE),
+                             m_bytesReserved(0),
+                             m_bytesUsed    (0),
+                             m_bytesSaved   (0)
+{}
+
+StringArena::~StringArena()
+{
+    for (char* block : m_blocks)
+        delete[] block;
+}
+
+void* StringArena::alloc(size_t size, size_t align)
+{
+    size_t offset = (m_blockUsed + align - 1) & ~(align - 1);
+
+    if (offset + size > BLOCK_SIZE)
+    {
+        // anything bigger than a block gets one to itself, at the front so
+        // the partly used last block keeps being filled
+        if (size > BLOCK_SIZE)
+        {
+            char* big = new char[size];
+            m_blocks.insert(m_blocks.begin(), big);
+            m_bytesReserved += size;
+            m_bytesUsed += size;
+            return big;
+        }
+
+        m_blocks.push_back(new char[BLOCK_SIZE]);
+        m_bytesReserved += BLOCK_SIZE;
+        offset = 0;
+    }
+
+    m_blockUsed = offset + size;
+    m_bytesUsed += size;
+    return m_blocks.back() + offset;
+}
+
+const char* StringArena::intern(const char* str)
+{
+    if (!str)
+        return nullptr;
+
+    const size_t length = strlen(str) + 1;
+    auto it = m_strings.find(str);
+    if (it != m_strings.end())
+    {
+        m_bytesSaved += length;
+        return *it;
+    }
+
+    char* copy = static_cast<char*>(alloc(length, 1));
+    memcpy(copy, str, length);
+    m_strings.insert(copy);
+    return copy;
+}
+
+const char** StringArena::internArray(const char* const* strs, size_t count)
+{
+    if (!count)
+        return nullptr;
+
+    const char** arr = static_cast<const char**>(alloc(count * sizeof(const char*), alignof(const char*)));
+    for (size_t i = 0; i < count; ++i)
+        arr[i] = intern(strs[i]);
+    return arr;
+}
+
+void StringArena::swap(StringArena& other)
+{
+    std::swap(m_blocks, other.m_blocks);
+    std::swap(m_blockUsed, other.m_blockUsed);
+    std::swap(m_bytesReserved, other.m_bytesReserved);
+    std::swap(m_bytesUsed, other.m_bytesUsed);
+    std::swap(m_bytesSaved, other.m_bytesSaved);
+    std::swap(m_strings, other.m_strings);
+}
+
+size_t StringArena::getBytesReserved()
+{
+    return m_bytesReserved;
+}
+
+size_t StringArena::getBytesUsed()
+{
+    return m_bytesUsed;
+}
+
+size_t StringArena::getBytesSaved()
+{
+    return m_bytesSaved;
+}
+
+// arena bytes a param's strings and options array take
+static size_t paramBytes(const RemoteParameter& param)
+{
+    size_t bytes = 0;
+    for (const char* str : { param.group, param.displayName, param.key })
+        bytes += str ? strlen(str) + 1 : 0;
+    for (uint32_t i = 0; param.options && i < param.nOptions; ++i)
+        bytes += strlen(param.options[i]) + 1 + sizeof(const char*);
+    return bytes;
+}
+
+RsScene::RsScene() : m_deadBytes (0), m_layoutDirty (false)
 {
     parameters = nullptr;
     nParameters = 0;
     
 }
 
-void RsScene::addParam(RemoteParameter param)
+void RsScene::internParam(RemoteParameter& param, StringArena& arena)
+{
+    param.group         = arena.intern(param.group);
+    param.displayName   = arena.intern(param.displayName);
+    param.key           = arena.intern(param.key);
+    param.options       = arena.internArray(param.options, param.nOptions);
+}
+
+void RsScene::addParam(const RemoteParameter& param, Object* obj)
 {
     m_params.push_back(param);
+    internParam(m_params.back(), m_strings);
     parameters = &m_params[0];
     ++nParameters;
+
+    const bool isImage = param.type == RS_PARAMETER_IMAGE;
+    const bool isNumber = param.type == RS_PARAMETER_NUMBER;
+
+    if (obj)
+    {
+        if (m_layout.slices.empty() || m_layout.slices.back().obj != obj)
+        {
+            ParamSlice slice;
+            slice.obj       = obj;
+            slice.first     = uint32_t(m_params.size() - 1);
+            slice.count     = 0;
+            slice.number    = m_layout.numbers;
+            slice.image     = m_layout.images;
+            slice.numbers   = 0;
+            slice.images    = 0;
+            m_sliceIndices[obj] = m_layout.slices.size();
+            m_layout.slices.push_back(slice);
+        }
+
+        ParamSlice& slice = m_layout.slices.back();
+        slice.count++;
+        slice.numbers += isNumber;
+        slice.images += isImage;
+    }
+
+    m_layout.numbers += isNumber;
+    m_layout.images += isImage;
 }
 
 void RsScene::removeParamsForObj(Object* obj)
 {
-    std::vector<RemoteParameter>::iterator it;
-    for (it = m_params.begin(); it != m_params.end();)
-        if (!strcmp(it->group, obj->getName()))
-            it = m_params.erase(it);
-        else ++it;
+    // the indices below have to be current
+    if (m_layoutDirty)
+        getLayout();
+
+    auto found = m_sliceIndices.find(obj);
+    if (found == m_sliceIndices.end())
+        return;
+
+    const size_t index = found->second;
+    const ParamSlice removed = m_layout.slices[index];
+    const ParamSlice last = m_layout.slices.back();
+    m_sliceIndices.erase(found);
+
+    for (uint32_t i = 0; i < removed.count; ++i)
+        m_deadBytes += paramBytes(m_params[removed.first + i]);
+
+    // the last object's params are moved into the hole, like ObjectStore::remove
+    // does with slots. every object has the same params so they fit exactly, and
+    // only the moved slice changes. the order d3 shows them in changes with it
+    if (last.count == removed.count && last.numbers == removed.numbers && last.images == removed.images)
+    {
+        if (last.obj != obj)
+        {
+            std::copy(m_params.begin() + last.first, m_params.begin() + last.first + last.count,
+                m_params.begin() + removed.first);
+
+            ParamSlice& moved = m_layout.slices[index];
+            moved = last;
+            moved.first = removed.first;
+            moved.number = removed.number;
+            moved.image = removed.image;
+            m_sliceIndices[last.obj] = index;
+        }
+        m_params.resize(m_params.size() - removed.count);
+        m_layout.slices.pop_back();
+    }
+    else
+    {
+        // a slice of another shape can't fill the hole, so later params move down.
+        // their offsets are worked out again when the layout is next asked for
+        m_params.erase(m_params.begin() + removed.first, m_params.begin() + removed.first + removed.count);
+        m_layout.slices.erase(m_layout.slices.begin() + index);
+        m_layoutDirty = true;
+    }
+    m_layout.numbers -= removed.numbers;
+    m_layout.images -= removed.images;
+
+    // once removed strings could be half the arena, copy what's left into a new
+    // arena and drop the old one. the schema is reloaded with the new pointers
+    // straight after this. doing it every time would make each remove copy every param
+    if (m_deadBytes * 2 > m_strings.getBytesUsed())
+    {
+        StringArena compacted;
+        for (RemoteParameter& param : m_params)
+            internParam(param, compacted);
+        m_strings.swap(compacted);
+        m_deadBytes = 0;
+    }
 
     parameters = m_params.size() ? &m_params[0] : nullptr;
     nParameters = m_params.size();
 }
 
+StringArena& RsScene::getStrings()
+{
+    return m_strings;
+}
+
+const ParamLayout& RsScene::getLayout()
+{
+    if (!m_layoutDirty)
+        return m_layout;
+
+    // the scene's own params come before any object's, and slices are still in
+    // parameter order, so they're laid out again one after another after those
+    uint32_t first = uint32_t(m_params.size());
+    uint32_t number = m_layout.numbers;
+    uint32_t image = m_layout.images;
+    for (const ParamSlice& slice : m_layout.slices)
+    {
+        first -= slice.count;
+        number -= slice.numbers;
+        image -= slice.images;
+    }
+
+    for (size_t i = 0; i < m_layout.slices.size(); ++i)
+    {
+        ParamSlice& slice = m_layout.slices[i];
+        slice.first = first;
+        slice.number = number;
+        slice.image = image;
+        first += slice.count;
+        number += slice.numbers;
+        image += slice.images;
+        m_sliceIndices[slice.obj] = i;
+    }
+    m_layoutDirty = false;
+    return m_layout;
+}
+
 RsFloatParam::RsFloatParam(const std::string& key, const std::string& display,
     const std::string& group, float defaultVal, float min, float max, float step,
     const std::vector<std::string>& opt, bool allowSequencing)
+    : m_key     (key),
+      m_display (display),
+      m_group   (group),
+      m_options (opt)
 {
     if (!opt.empty())
     {
@@ -291,21 +578,19 @@ RsFloatParam::RsFloatParam(const std::string& key, const std::string& display,
         step = 1;
     }
 
-    this->group                     = _strdup(group.c_str());
-    this->displayName               = _strdup(display.c_str());
-    this->key                       = _strdup(key.c_str());
+    for (const std::string& option : m_options)
+        m_optionPtrs.push_back(option.c_str());
+
+    this->group                     = m_group.c_str();
+    this->displayName               = m_display.c_str();
+    this->key                       = m_key.c_str();
     this->type                      = RS_PARAMETER_NUMBER;
     defaults.number.defaultValue    = defaultVal;
     defaults.number.min             = min;
     defaults.number.max             = max;
     defaults.number.step            = step;
-    nOptions                        = uint32_t(opt.size());
-    options                         = static_cast<const char**>(malloc(nOptions * sizeof(const char*)));
-
-    for (size_t j = 0; j < opt.size(); ++j)
-    {
-        options[j] = _strdup(opt[j].c_str());
-    }
+    nOptions                        = uint32_t(m_optionPtrs.size());
+    options                         = m_optionPtrs.empty() ? nullptr : &m_optionPtrs[0];
 
     dmxOffset                       = -1; // Auto
     dmxType                         = RS_DMX_16_BE;
@@ -317,10 +602,13 @@ RsFloatParam::RsFloatParam(const std::string& key, const std::string& display,
 
 RsTextureParam::RsTextureParam(const std::string& key, const std::string& display,
                                 const std::string& group)
+    : m_key     (key),
+      m_display (display),
+      m_group   (group)
 {
-    this->group                     = _strdup(group.c_str());
-    this->displayName               = _strdup(display.c_str());
-    this->key                       = _strdup(key.c_str());
+    this->group                     = m_group.c_str();
+    this->displayName               = m_display.c_str();
+    this->key                       = m_key.c_str();
     this->type                      = RS_PARAMETER_IMAGE;
 
     nOptions                        = 0;
@@ -330,16 +618,16 @@ RsTextureParam::RsTextureParam(const std::string& key, const std::string& displa
     flags                           = REMOTEPARAMETER_NO_FLAGS;
 }
 
-VertexArray::VertexArray()
+unsigned int VertexArray::s_nextId = 1;
+
+VertexArray::VertexArray() : m_id (s_nextId++), m_radius (0)
 {
-    glGenVertexArrays(1, &m_vao);
     glGenBuffers(1, &m_vbo);
     glGenBuffers(1, &m_ibo);
 }
 
 VertexArray::~VertexArray()
 {
-    glDeleteVertexArrays(1, &m_vao);
     glDeleteBuffers(1, &m_vbo);
     glDeleteBuffers(1, &m_ibo);
 }
@@ -366,14 +654,27 @@ void VertexArray::setIndices(const std::vector<unsigned int>& indices)
     m_indices = indices;
 }
 
-void VertexArray::bind() { glBindVertexArray(m_vao); }
-
 void VertexArray::build()
 {
-    bind();
+    // positions are the first three of every eight floats
+    m_radius = 0;
+    for (size_t i = 0; i + 2 < m_vertices.size(); i += 8)
+        m_radius = std::max(m_radius, glm::length(glm::vec3(m_vertices[i], m_vertices[i + 1], m_vertices[i + 2])));
+
     glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
     glBufferData(GL_ARRAY_BUFFER, sizeof(float) * m_vertices.size(), &m_vertices[0], GL_STATIC_DRAW);
 
+    // the element binding belongs to a vertex array object, so upload
+    // indices through the array binding instead, buffers are typeless
+    glBindBuffer(GL_ARRAY_BUFFER, m_ibo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(unsigned int) * m_indices.size(), &m_indices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexArray::setupAttribs()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+
     // set up position attrib
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, 0);
@@ -387,10 +688,24 @@ void VertexArray::build()
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 8, (const void*)20);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * m_indices.size(), &m_indices[0], GL_STATIC_DRAW);
+}
+
+unsigned int VertexArray::getId()
+{
+    return m_id;
 }
 
 size_t VertexArray::getIndexCount()
 {
     return m_indices.size();
-}
\ No newline at end of file
+}
+
+float VertexArray::getRadius()
+{
+    return m_radius;
+}
+
+size_t VertexArray::getByteSize()
+{
+    return sizeof(float) * m_vertices.size() + sizeof(unsigned int) * m_indices.size();
+}